@@ -5,9 +5,12 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 #include "socket.h"
+#include "status_page.h"
+#include "timekeeper.h"
 
 void print_usage(const char *program_name) {
     printf("Usage: %s <command> [args]\n", program_name);
+    printf("       %s --shm [status]\n", program_name);
     printf("Commands:\n");
     printf("  pause              Pause the current task\n");
     printf("  resume             Resume the paused task\n");
@@ -15,7 +18,126 @@ void print_usage(const char *program_name) {
     printf("  previous           Go back to the previous task\n");
     printf("  extend <minutes>   Extend the current task by specified minutes\n");
     printf("  status             Get the current status of ChronoTask\n");
+    printf("  watch [--tick]     Stream status records as the state changes\n");
+    printf("  config             Show the running configuration\n");
+    printf("  config get <key>   Show one configuration value\n");
+    printf("  config set <key> <value>\n");
+    printf("                     Change a configuration value until the next reload\n");
+    printf("  stats [json]       Show runtime counters and latency histograms\n");
     printf("  abort              Terminate the ChronoTask program\n");
+    printf("Options:\n");
+    printf("  --shm              Read the status from the shared status page without contacting the daemon\n");
+}
+
+int read_status_page(void) {
+    const StatusPage *page = status_page_map();
+    if (!page) {
+        fprintf(stderr, "Error: status page %s is not available\n", status_page_path());
+        return 1;
+    }
+
+    StatusPage snapshot;
+    if (!status_page_read(page, &snapshot)) {
+        fprintf(stderr, "Error: status page has not been published yet\n");
+        return 1;
+    }
+
+    printf("Routine: %s, Task %d/%d: %s, Time remaining: %d seconds, Status: %s\n",
+           snapshot.routine_name, snapshot.task_index + 1, snapshot.task_count, snapshot.task_name,
+           ns_to_display_seconds(status_page_remaining(&snapshot)),
+           snapshot.paused ? "Paused" : "Running");
+    return 0;
+}
+
+int watch_status(int sock) {
+    Buffer pending = {0};
+    Buffer record = {0};
+    int status;
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    while ((status = receive_frame(sock, &pending, &record)) > 0) {
+        printf("%s\n", record.data ? record.data : "");
+    }
+
+    buffer_free(&pending);
+    buffer_free(&record);
+    return status == 0 ? 0 : -1;
+}
+
+int is_simple_command(const char *command) {
+    return strcmp(command, "pause") == 0 ||
+           strcmp(command, "resume") == 0 ||
+           strcmp(command, "next") == 0 ||
+           strcmp(command, "previous") == 0 ||
+           strcmp(command, "status") == 0 ||
+           strcmp(command, "abort") == 0;
+}
+
+int parse_commands(int argc, char *argv[], Buffer *request, int *watch, int *raw) {
+    int count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *command = argv[i];
+
+        if (*watch) {
+            fprintf(stderr, "Error: 'watch' must be the last command\n");
+            return -1;
+        }
+
+        if (is_simple_command(command)) {
+            buffer_printf(request, "%s\n", command);
+        } else if (strcmp(command, "watch") == 0) {
+            if (i + 1 < argc && strcmp(argv[i + 1], "--tick") == 0) {
+                buffer_printf(request, "subscribe tick\n");
+                i++;
+            } else {
+                buffer_printf(request, "subscribe\n");
+            }
+            *watch = 1;
+        } else if (strcmp(command, "extend") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: 'extend' command requires minutes argument\n");
+                return -1;
+            }
+            buffer_printf(request, "extend %s\n", argv[++i]);
+        } else if (strcmp(command, "config") == 0) {
+            if (i + 1 < argc && strcmp(argv[i + 1], "get") == 0) {
+                if (i + 2 >= argc) {
+                    fprintf(stderr, "Error: 'config get' requires a key\n");
+                    return -1;
+                }
+                buffer_printf(request, "config get %s\n", argv[i + 2]);
+                i += 2;
+            } else if (i + 1 < argc && strcmp(argv[i + 1], "set") == 0) {
+                if (i + 3 >= argc) {
+                    fprintf(stderr, "Error: 'config set' requires a key and a value\n");
+                    return -1;
+                }
+                if (strchr(argv[i + 2], '\n') || strchr(argv[i + 3], '\n')) {
+                    fprintf(stderr, "Error: configuration values cannot contain newlines\n");
+                    return -1;
+                }
+                buffer_printf(request, "config set %s %s\n", argv[i + 2], argv[i + 3]);
+                i += 3;
+            } else {
+                buffer_printf(request, "config\n");
+            }
+        } else if (strcmp(command, "stats") == 0) {
+            if (i + 1 < argc && strcmp(argv[i + 1], "json") == 0) {
+                buffer_printf(request, "stats json\n");
+                *raw = 1;
+                i++;
+            } else {
+                buffer_printf(request, "stats\n");
+            }
+        } else {
+            fprintf(stderr, "Error: Unknown command '%s'\n", command);
+            print_usage(argv[0]);
+            return -1;
+        }
+        count++;
+    }
+    return count;
 }
 
 int main(int argc, char *argv[]) {
@@ -24,25 +146,20 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    const char *command = argv[1];
-    char full_command[BUFFER_SIZE];
-
-    if (strcmp(command, "pause") == 0 || 
-        strcmp(command, "resume") == 0 || 
-        strcmp(command, "next") == 0 || 
-        strcmp(command, "previous") == 0 ||
-        strcmp(command, "status") == 0 ||
-        strcmp(command, "abort") == 0) {
-        strncpy(full_command, command, BUFFER_SIZE);
-    } else if (strcmp(command, "extend") == 0) {
-        if (argc < 3) {
-            fprintf(stderr, "Error: 'extend' command requires minutes argument\n");
+    if (strcmp(argv[1], "--shm") == 0) {
+        if (argc > 2 && strcmp(argv[2], "status") != 0) {
+            fprintf(stderr, "Error: only 'status' is available with --shm\n");
             return 1;
         }
-        snprintf(full_command, BUFFER_SIZE, "extend %s", argv[2]);
-    } else {
-        fprintf(stderr, "Error: Unknown command '%s'\n", command);
-        print_usage(argv[0]);
+        return read_status_page();
+    }
+
+    Buffer request = {0};
+    int watch = 0;
+    int raw = 0;
+    int command_count = parse_commands(argc, argv, &request, &watch, &raw);
+    if (command_count <= 0) {
+        buffer_free(&request);
         return 1;
     }
 
@@ -63,17 +180,37 @@ int main(int argc, char *argv[]) {
         return -1;
     }
 
-    if (send_message(sock, full_command) == -1) {
+    if (send_message(sock, request.data) == -1) {
         perror("send_message");
         close(sock);
         return -1;
     }
+    buffer_free(&request);
+
+    Buffer pending = {0};
+    Buffer response = {0};
+    int responses = watch ? command_count - 1 : command_count;
+    int result = 0;
+
+    for (int i = 0; i < responses; i++) {
+        if (receive_frame(sock, &pending, &response) <= 0) {
+            fprintf(stderr, "Error: connection closed before all responses arrived\n");
+            result = -1;
+            break;
+        }
+        if (raw && command_count == 1) {
+            printf("%s\n", response.data ? response.data : "");
+        } else {
+            printf("Response: %s\n", response.data ? response.data : "");
+        }
+    }
 
-    char response[BUFFER_SIZE];
-    if (receive_message(sock, response, BUFFER_SIZE) > 0) {
-        printf("Response: %s\n", response);
+    if (watch && result == 0) {
+        result = watch_status(sock);
     }
 
+    buffer_free(&pending);
+    buffer_free(&response);
     close(sock);
-    return 0;
+    return result;
 }
@@ -0,0 +1,24 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARENA_INVALID UINT32_MAX
+
+typedef struct {
+    char *data;
+    size_t used;
+    size_t capacity;
+    uint32_t *intern_slots;
+    size_t intern_capacity;
+    size_t intern_count;
+} Arena;
+
+void arena_init(Arena *arena);
+void arena_free(Arena *arena);
+uint32_t arena_alloc(Arena *arena, size_t size, size_t align);
+uint32_t arena_push(Arena *arena, const void *data, size_t size, size_t align);
+uint32_t arena_intern(Arena *arena, const char *string);
+
+#endif
@@ -3,9 +3,16 @@
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_mixer.h>
+#include <stdint.h>
+#include "task.h"
 
-int initialize_audio();
+void start_audio(void);
+int load_notification_sound();
 void play_notification_sound();
+void play_sound(const char *name);
+void audio_use_routine(const Routine *routine);
+void audio_update(int paused, int64_t next_sound, const char *next_sound_name);
+int audio_poll_timeout(void);
 void cleanup_audio();
 
 #endif
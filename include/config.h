@@ -2,6 +2,7 @@
 #define CONFIG_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 typedef enum {
     H_LEFT,
@@ -41,13 +42,53 @@ typedef struct {
     Color menu_highlight_color;
     double menu_font_size;
     char menu_font_name[64];
+    bool count_suspend;
+    int socket_backlog;
+    int client_idle_timeout;
+    bool audio_on_demand;
+    int audio_idle_timeout;
+    char metrics_file[256];
 } ChronoTaskConfig;
 
+typedef enum {
+    CONFIG_STRING,
+    CONFIG_INT,
+    CONFIG_DOUBLE,
+    CONFIG_BOOL,
+    CONFIG_COLOR,
+    CONFIG_FONT_WEIGHT,
+    CONFIG_HPOS,
+    CONFIG_VPOS
+} ConfigType;
+
+typedef enum {
+    CONFIG_LIVE,
+    CONFIG_RESTART
+} ConfigApply;
+
+typedef struct ConfigKey ConfigKey;
+
+struct ConfigKey {
+    const char *name;
+    ConfigType type;
+    size_t offset;
+    size_t size;
+    const char *default_value;
+    const char *(*validate)(const ConfigKey *key, const void *value);
+    ConfigApply apply;
+};
+
 extern ChronoTaskConfig config;
+extern const ConfigKey config_keys[];
+extern const int config_key_count;
 
 int load_config(const char* filename);
-int string_to_font_weight(const char *weight_str);
-Color parse_color(const char* color_str);
-char* get_config_path(const char* filename);
+int load_config_file(const char* config_path, ChronoTaskConfig *target);
+void config_set_defaults(ChronoTaskConfig *target);
+const ConfigKey *config_find_key(const char *name);
+int config_set_value(ChronoTaskConfig *target, const ConfigKey *key, const char *value,
+                     char *error, size_t error_size);
+void config_format_value(const ChronoTaskConfig *source, const ConfigKey *key, char *buffer, size_t size);
+int get_config_path(const char* filename, char *path, size_t size);
 
 #endif
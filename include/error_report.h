@@ -3,6 +3,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include "log_format.h"
+
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 0
+#endif
 
 typedef enum {
     LOG_DEBUG,
@@ -12,17 +17,58 @@ typedef enum {
     LOG_FATAL
 } LogLevel;
 
+typedef enum {
+    LOG_OUTPUT_TEXT,
+    LOG_OUTPUT_BINARY
+} LogOutput;
+
+typedef struct {
+    unsigned long written;
+    unsigned long dropped;
+} LogStats;
+
 extern LogLevel current_log_level;
 
-void initialize_logging(const char* log_file);
+void initialize_logging(const char* log_file, LogOutput output);
 void cleanup_logging(void);
 void set_log_level(LogLevel level);
-void log_message(LogLevel level, const char* file, int line, const char* format, ...);
+void get_log_stats(LogStats *stats);
+void log_message(LogSite *site, const char* format, ...);
+
+#define LOG_AT(level, ...) do { \
+        static LogSite log_site = { level, __LINE__, __FILE__, 0 }; \
+        if (current_log_level <= level) log_message(&log_site, __VA_ARGS__); \
+    } while (0)
+#define LOG_STRIPPED(...) do { if (0) log_message(NULL, __VA_ARGS__); } while (0)
+
+#if LOG_COMPILE_LEVEL <= 0
+#define LOG_DEBUG(...) LOG_AT(LOG_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) LOG_STRIPPED(__VA_ARGS__)
+#endif
+
+#if LOG_COMPILE_LEVEL <= 1
+#define LOG_INFO(...) LOG_AT(LOG_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) LOG_STRIPPED(__VA_ARGS__)
+#endif
+
+#if LOG_COMPILE_LEVEL <= 2
+#define LOG_WARNING(...) LOG_AT(LOG_WARNING, __VA_ARGS__)
+#else
+#define LOG_WARNING(...) LOG_STRIPPED(__VA_ARGS__)
+#endif
+
+#if LOG_COMPILE_LEVEL <= 3
+#define LOG_ERROR(...) LOG_AT(LOG_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) LOG_STRIPPED(__VA_ARGS__)
+#endif
 
-#define LOG_DEBUG(...) if(current_log_level <= LOG_DEBUG) log_message(LOG_DEBUG, __FILE__, __LINE__, __VA_ARGS__)
-#define LOG_INFO(...) if(current_log_level <= LOG_INFO) log_message(LOG_INFO, __FILE__, __LINE__, __VA_ARGS__)
-#define LOG_WARNING(...) if(current_log_level <= LOG_WARNING) log_message(LOG_WARNING, __FILE__, __LINE__, __VA_ARGS__)
-#define LOG_ERROR(...) if(current_log_level <= LOG_ERROR) log_message(LOG_ERROR, __FILE__, __LINE__, __VA_ARGS__)
-#define LOG_FATAL(...) do { log_message(LOG_FATAL, __FILE__, __LINE__, __VA_ARGS__); exit(EXIT_FAILURE); } while(0)
+#define LOG_FATAL(...) do { \
+        static LogSite log_site = { LOG_FATAL, __LINE__, __FILE__, 0 }; \
+        log_message(&log_site, __VA_ARGS__); \
+        exit(EXIT_FAILURE); \
+    } while (0)
 
 #endif
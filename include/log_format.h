@@ -0,0 +1,84 @@
+#ifndef LOG_FORMAT_H
+#define LOG_FORMAT_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define LOG_MAX_ARGS 16
+#define LOG_STRING_SPACE 512
+#define LOG_MESSAGE_MAX 1024
+#define LOG_LINE_MAX (LOG_MESSAGE_MAX + 256)
+
+#define LOG_BINARY_MAGIC "CTBLOG1\n"
+#define LOG_BINARY_MAGIC_LEN 8
+#define LOG_BINARY_ENTRY_MAX 4096
+
+typedef enum {
+    LOG_BINARY_SESSION = 1,
+    LOG_BINARY_SITE,
+    LOG_BINARY_EVENT
+} LogBinaryType;
+
+typedef enum {
+    LOG_ARG_INT,
+    LOG_ARG_UINT,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_POINTER,
+    LOG_ARG_STRING
+} LogArgType;
+
+typedef struct {
+    uint8_t type;
+    union {
+        long long i;
+        unsigned long long u;
+        double d;
+        const void *p;
+        uint16_t offset;
+    } value;
+} LogArg;
+
+typedef struct {
+    int level;
+    int line;
+    const char *file;
+    uint32_t id;
+} LogSite;
+
+typedef struct {
+    LogSite *site;
+    const char *format;
+    time_t timestamp;
+    uint16_t arg_count;
+    uint16_t string_len;
+    LogArg args[LOG_MAX_ARGS];
+    char strings[LOG_STRING_SPACE];
+} LogRecord;
+
+typedef struct {
+    LogBinaryType type;
+    time_t timestamp;
+    uint32_t pid;
+    uint32_t site_id;
+    int level;
+    int line;
+    const char *file;
+    size_t file_len;
+    const char *format;
+    size_t format_len;
+    LogRecord record;
+} LogBinaryEntry;
+
+const char *log_level_name(int level);
+void log_capture(LogRecord *record, const char *format, va_list args);
+size_t log_format_message(const LogRecord *record, char *out, size_t size);
+size_t log_format_line(const LogRecord *record, char *out, size_t size);
+
+size_t log_encode_session(uint8_t *out, time_t timestamp, uint32_t pid);
+size_t log_encode_site(uint8_t *out, const LogSite *site, const char *format);
+size_t log_encode_event(uint8_t *out, const LogRecord *record, time_t *last_timestamp);
+size_t log_decode_entry(const uint8_t *data, size_t len, time_t *last_timestamp, LogBinaryEntry *entry);
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+void metrics_task_completed(void);
+void metrics_task_paused(void);
+void metrics_task_extended(int seconds);
+void metrics_update(void);
+void metrics_cleanup(void);
+
+#endif
@@ -1,10 +1,24 @@
 #ifndef OVERLAY_H
 #define OVERLAY_H
 
-#include <time.h>
+#include "config.h"
 
-void draw_overlay(int is_paused, time_t elapsed_time);
+typedef struct {
+    unsigned long frames;
+    unsigned long requests;
+    unsigned long round_trips;
+    unsigned long cache_hits;
+    unsigned long cache_misses;
+} OverlayStats;
+
+void overlay_preload_fonts(void);
+void overlay_wait_for_fonts(void);
+int initialize_overlay_resources(void);
+void draw_overlay(int is_paused, int remaining_seconds);
 void cleanup_overlay_resources(void);
+void overlay_invalidate(void);
+void overlay_apply_config(const ChronoTaskConfig *previous);
+void get_overlay_stats(OverlayStats *stats);
 
 #endif
 
@@ -0,0 +1,15 @@
+#ifndef RELOAD_H
+#define RELOAD_H
+
+#include <poll.h>
+#include "config.h"
+
+#define RELOAD_POLL_FDS 2
+
+int reload_init(const char *config_file);
+int reload_fill_pollfds(struct pollfd *fds, int max_fds);
+int reload_handle_events(const struct pollfd *fds, int nfds);
+void reload_apply_config(const ChronoTaskConfig *fresh);
+void reload_cleanup(void);
+
+#endif
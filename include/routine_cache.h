@@ -0,0 +1,30 @@
+#ifndef ROUTINE_CACHE_H
+#define ROUTINE_CACHE_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include "task.h"
+
+#define ROUTINE_CACHE_MAGIC 0x43525443
+#define ROUTINE_CACHE_VERSION 3
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t record_size;
+    uint64_t source_size;
+    int64_t source_mtime_sec;
+    int64_t source_mtime_nsec;
+    uint32_t path_len;
+    uint32_t routine_count;
+    uint64_t records_offset;
+    uint64_t arena_offset;
+    uint64_t arena_size;
+    uint64_t checksum;
+} RoutineCacheHeader;
+
+int routine_cache_load(const char *source_path, RoutineList *list);
+int routine_cache_store(const char *source_path, const struct stat *source, const RoutineList *list);
+
+#endif
@@ -2,7 +2,8 @@
 #define ROUTINE_SELECTOR_H
 
 #include "task.h"
+#include <X11/Xlib.h>
 
-int select_routine_gui(RoutineList *routines);
+int select_routine_gui(Display *display, RoutineList *routines);
 
 #endif
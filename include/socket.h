@@ -1,15 +1,69 @@
 #ifndef SOCKET_H
 #define SOCKET_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 
 #define SOCKET_PATH "/tmp/chronotask.sock"
 #define BUFFER_SIZE 1024
+#define MAX_CLIENTS 64
+#define DEFAULT_LISTEN_BACKLOG 5
+#define DEFAULT_CLIENT_IDLE_TIMEOUT 10
+#define SUBSCRIBER_BUFFER_LIMIT 16384
+#define MAX_PENDING_INPUT 65536
+#define OUTPUT_HIGH_WATER 65536
 
-int create_socket(void);
+typedef enum {
+    SUBSCRIBE_NONE,
+    SUBSCRIBE_CHANGES,
+    SUBSCRIBE_TICKS
+} Subscription;
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} Buffer;
+
+typedef struct {
+    int fd;
+    Buffer in;
+    Buffer out;
+    int64_t last_activity;
+    int close_after_write;
+    Subscription subscription;
+} Client;
+
+typedef struct {
+    int listen_fd;
+    Client clients[MAX_CLIENTS];
+    int client_count;
+    int64_t idle_timeout;
+    unsigned long dropped_subscribers;
+} CommandServer;
+
+typedef Subscription (*CommandHandler)(const char *cmd, Buffer *response);
+
+int buffer_append(Buffer *buffer, const char *data, size_t len);
+int buffer_printf(Buffer *buffer, const char *format, ...);
+void buffer_consume(Buffer *buffer, size_t len);
+void buffer_free(Buffer *buffer);
+
+int create_socket(int backlog);
 int accept_connection(int server_socket);
 int send_message(int socket, const char *message);
-int receive_message(int socket, char *buffer, int buffer_size);
+int frame_append(Buffer *out, const char *payload, size_t len);
+int receive_frame(int socket, Buffer *pending, Buffer *payload);
+
+int server_init(CommandServer *server, int backlog, int idle_timeout_seconds);
+int server_fill_pollfds(CommandServer *server, struct pollfd *fds, int max_fds);
+void server_handle_events(CommandServer *server, const struct pollfd *fds, int nfds);
+void server_process_commands(CommandServer *server, CommandHandler handler);
+void server_broadcast(CommandServer *server, Subscription level, const char *record, size_t len);
+int server_poll_timeout(const CommandServer *server);
+void server_close(CommandServer *server);
 
 #endif
@@ -0,0 +1,17 @@
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <stdint.h>
+
+int64_t startup_now(void);
+void startup_begin(void);
+void startup_set_trace_file(const char *path);
+void startup_set_thread(const char *name);
+void startup_phase(const char *name, int64_t start);
+void startup_stage(const char *name);
+void startup_wait(const char *name);
+void startup_task_begin(void);
+void startup_task_end(const char *name, int64_t start);
+void startup_first_frame(void);
+
+#endif
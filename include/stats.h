@@ -0,0 +1,56 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include "socket.h"
+
+#define HISTOGRAM_BUCKETS 40
+
+typedef struct {
+    unsigned long count;
+    int64_t total_ns;
+    int64_t max_ns;
+    unsigned long buckets[HISTOGRAM_BUCKETS];
+} Histogram;
+
+typedef enum {
+    COMMAND_PAUSE,
+    COMMAND_RESUME,
+    COMMAND_NEXT,
+    COMMAND_PREVIOUS,
+    COMMAND_EXTEND,
+    COMMAND_STATUS,
+    COMMAND_SUBSCRIBE,
+    COMMAND_CONFIG,
+    COMMAND_STATS,
+    COMMAND_ABORT,
+    COMMAND_OTHER,
+    COMMAND_TYPE_COUNT
+} CommandType;
+
+typedef struct {
+    int64_t loop_start;
+    unsigned long loop_iterations;
+    unsigned long wakeups;
+    Histogram frame_time;
+    Histogram commands[COMMAND_TYPE_COUNT];
+} RuntimeStats;
+
+extern RuntimeStats runtime_stats;
+
+void histogram_record(Histogram *histogram, int64_t ns);
+int64_t histogram_percentile(const Histogram *histogram, double fraction);
+
+void stats_loop_start(void);
+void stats_loop_iteration(void);
+void stats_wakeup(void);
+void stats_frame(int64_t render_ns);
+void stats_command(const char *cmd, int64_t latency_ns);
+const char *stats_command_name(CommandType type);
+
+long stats_rss_bytes(void);
+int stats_open_fds(void);
+void stats_format_text(Buffer *out);
+void stats_format_json(Buffer *out);
+
+#endif
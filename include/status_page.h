@@ -0,0 +1,35 @@
+#ifndef STATUS_PAGE_H
+#define STATUS_PAGE_H
+
+#include <stdint.h>
+
+#define STATUS_PAGE_NAME "chronotask-status"
+#define STATUS_PAGE_MAGIC 0x50535443
+#define STATUS_PAGE_VERSION 1
+#define STATUS_NAME_MAX 256
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sequence;
+    int32_t clock_id;
+    int64_t deadline;
+    int64_t remaining;
+    int32_t paused;
+    int32_t task_index;
+    int32_t task_count;
+    int32_t loops_remaining;
+    char routine_name[STATUS_NAME_MAX];
+    char task_name[STATUS_NAME_MAX];
+} StatusPage;
+
+const char *status_page_path(void);
+int status_page_create(void);
+void status_page_publish(const StatusPage *state);
+void status_page_destroy(void);
+
+const StatusPage *status_page_map(void);
+int status_page_read(const StatusPage *page, StatusPage *snapshot);
+int64_t status_page_remaining(const StatusPage *snapshot);
+
+#endif
@@ -1,43 +1,97 @@
 #ifndef TASK_H
 #define TASK_H
 
-#include <time.h>
-
-#define MAX_TASK_NAME 256
-#define MAX_TASKS 100
-#define MAX_ROUTINES 10
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
 
 typedef struct {
-    char name[MAX_TASK_NAME];
-    int duration;
-} Task;
+    uint32_t name;
+    uint32_t task_names;
+    uint32_t durations;
+    uint32_t task_sounds;
+    int32_t task_count;
+    int32_t loop;
+    int32_t inf_loop;
+    uint32_t sound;
+    uint32_t complete_sound;
+    uint32_t warning_sound;
+    int32_t warn_before;
+} RoutineRecord;
 
 typedef struct {
-    char name[MAX_TASK_NAME];
-    Task tasks[MAX_TASKS];
+    const char *name;
+    const char *strings;
+    const uint32_t *task_names;
+    const int32_t *durations;
+    const uint32_t *task_sounds;
     int task_count;
     int loop;
     int inf_loop;
+    const char *sound;
+    const char *complete_sound;
+    const char *warning_sound;
+    int warn_before;
 } Routine;
 
 typedef struct {
-    Routine routines[MAX_ROUTINES];
+    uint64_t start;
+    uint64_t end;
+    int loaded;
+} RoutineSpan;
+
+typedef struct {
+    char *source_path;
+    int64_t source_size;
+    int64_t source_mtime_sec;
+    int64_t source_mtime_nsec;
+    RoutineSpan *spans;
+} RoutineIndex;
+
+typedef struct {
+    Arena arena;
+    RoutineRecord *records;
+    Routine *routines;
     int routine_count;
+    int routine_capacity;
+    void *mapping;
+    size_t mapping_size;
+    RoutineIndex *index;
 } RoutineList;
 
 extern RoutineList routine_list;
 extern int current_routine;
 
-int load_routines(const char* directory);
+int load_routines(const char* name);
+int resolve_routines_path(const char *name, char *path, size_t size);
+const char *get_routines_path(void);
+int load_routines_from(const char *source_path, RoutineList *list);
+int replace_routines(RoutineList *fresh);
+int finalize_routines(RoutineList *list);
+void free_routines(RoutineList *list);
+void cleanup_routines(void);
+const char* get_routine_task_name(const Routine *routine, int index);
+const char* get_routine_task_sound(const Routine *routine, int index);
 int select_routine(const char* routine_name);
 void list_routines();
 void reset_routine();
+int start_next_routine_loop(void);
 int initialize_tasks();
 int move_to_next_task(void);
+int finish_current_task(void);
 void move_to_previous_task(void);
 void extend_current_task(int seconds);
+int pause_current_task(void);
+int resume_current_task(void);
+int is_task_paused(void);
+int64_t get_task_remaining_ns(void);
+int64_t get_next_tick_time(void);
 const char* get_current_task_name(void);
+const char* get_current_task_sound(void);
+int64_t get_next_sound_ns(void);
+const char* get_next_sound_name(void);
+int take_task_warning(void);
+int get_current_task_index(void);
 int get_current_task_duration(void);
-time_t get_task_start_time(void);
 
 #endif
@@ -0,0 +1,8 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <pthread.h>
+
+int start_worker_thread(pthread_t *thread, void *(*function)(void *), void *arg);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef TIMEKEEPER_H
+#define TIMEKEEPER_H
+
+#include <stdint.h>
+#include <time.h>
+
+#define NSEC_PER_SEC 1000000000LL
+
+typedef struct {
+    int64_t deadline;
+    int64_t paused_at;
+    int paused;
+} Countdown;
+
+void set_timekeeping_clock(clockid_t clock_id);
+clockid_t get_timekeeping_clock(void);
+int64_t now_ns(void);
+int ns_to_display_seconds(int64_t ns);
+
+void countdown_start(Countdown *countdown, int64_t duration);
+void countdown_start_at(Countdown *countdown, int64_t start, int64_t duration);
+int countdown_pause(Countdown *countdown);
+int countdown_resume(Countdown *countdown);
+void countdown_extend(Countdown *countdown, int64_t amount);
+int64_t countdown_remaining(const Countdown *countdown);
+int64_t countdown_next_tick(const Countdown *countdown);
+
+#endif
@@ -1,10 +1,15 @@
 #ifndef WINDOW_H
 #define WINDOW_H
 
+#include <X11/Xlib.h>
+
 void create_transparent_window();
 int initialize_display();
 void cleanup_display();
 void handle_x11_events();
+Display *get_display(void);
+int get_display_fd(void);
+int x11_events_queued(void);
 
 #endif
 
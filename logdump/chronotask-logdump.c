@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "log_format.h"
+
+typedef struct {
+    LogSite site;
+    char *file;
+    char *format;
+} SiteDefinition;
+
+typedef struct {
+    SiteDefinition *sites;
+    size_t count;
+} SiteTable;
+
+void print_usage(const char *program_name) {
+    printf("Usage: %s [binary log file...]\n", program_name);
+    printf("Decodes a log written with 'chronotask --binary-log' into text lines.\n");
+    printf("Defaults to chronoTask.binlog in the current directory.\n");
+}
+
+void clear_sites(SiteTable *table) {
+    for (size_t i = 0; i < table->count; i++) {
+        free(table->sites[i].file);
+        free(table->sites[i].format);
+    }
+    free(table->sites);
+    table->sites = NULL;
+    table->count = 0;
+}
+
+char *copy_bytes(const char *bytes, size_t length) {
+    char *copy = malloc(length + 1);
+    if (copy) {
+        memcpy(copy, bytes, length);
+        copy[length] = '\0';
+    }
+    return copy;
+}
+
+int define_site(SiteTable *table, const LogBinaryEntry *entry) {
+    if (entry->site_id == 0) {
+        return 0;
+    }
+    if (entry->site_id >= table->count) {
+        size_t count = entry->site_id + 1;
+        SiteDefinition *sites = realloc(table->sites, count * sizeof(SiteDefinition));
+        if (!sites) {
+            return 0;
+        }
+        memset(sites + table->count, 0, (count - table->count) * sizeof(SiteDefinition));
+        table->sites = sites;
+        table->count = count;
+    }
+
+    SiteDefinition *definition = &table->sites[entry->site_id];
+    free(definition->file);
+    free(definition->format);
+    definition->file = copy_bytes(entry->file, entry->file_len);
+    definition->format = copy_bytes(entry->format, entry->format_len);
+    definition->site.level = entry->level;
+    definition->site.line = entry->line;
+    definition->site.file = definition->file;
+    definition->site.id = entry->site_id;
+    return definition->file && definition->format;
+}
+
+unsigned char *read_file(const char *path, size_t *size) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return NULL;
+    }
+
+    size_t capacity = 65536;
+    unsigned char *data = malloc(capacity);
+    *size = 0;
+    while (data) {
+        size_t n = fread(data + *size, 1, capacity - *size, file);
+        *size += n;
+        if (*size < capacity) {
+            break;
+        }
+        capacity *= 2;
+        unsigned char *grown = realloc(data, capacity);
+        if (!grown) {
+            free(data);
+        }
+        data = grown;
+    }
+
+    if (!data || ferror(file)) {
+        fprintf(stderr, "%s: read failed\n", path);
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    return data;
+}
+
+int dump_log(const char *path) {
+    size_t size;
+    unsigned char *data = read_file(path, &size);
+    if (!data) {
+        return 1;
+    }
+
+    if (size < LOG_BINARY_MAGIC_LEN || memcmp(data, LOG_BINARY_MAGIC, LOG_BINARY_MAGIC_LEN) != 0) {
+        fprintf(stderr, "%s: not a chronotask binary log\n", path);
+        free(data);
+        return 1;
+    }
+
+    SiteTable table = {0};
+    LogBinaryEntry entry;
+    char line[LOG_LINE_MAX];
+    time_t last_timestamp = 0;
+    size_t pos = LOG_BINARY_MAGIC_LEN;
+    int result = 0;
+
+    while (pos < size) {
+        size_t consumed = log_decode_entry(data + pos, size - pos, &last_timestamp, &entry);
+        if (consumed == 0) {
+            fprintf(stderr, "%s: corrupt or truncated record at offset %zu\n", path, pos);
+            result = 1;
+            break;
+        }
+        pos += consumed;
+
+        if (entry.type == LOG_BINARY_SESSION) {
+            clear_sites(&table);
+        } else if (entry.type == LOG_BINARY_SITE) {
+            if (!define_site(&table, &entry)) {
+                fprintf(stderr, "%s: invalid call site %u\n", path, entry.site_id);
+                result = 1;
+                break;
+            }
+        } else if (entry.site_id >= table.count || !table.sites[entry.site_id].format) {
+            fprintf(stderr, "%s: event references unknown call site %u\n", path, entry.site_id);
+        } else {
+            SiteDefinition *definition = &table.sites[entry.site_id];
+            entry.record.site = &definition->site;
+            entry.record.format = definition->format;
+            fwrite(line, 1, log_format_line(&entry.record, line, sizeof(line)), stdout);
+        }
+    }
+
+    clear_sites(&table);
+    free(data);
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+        print_usage(argv[0]);
+        return 0;
+    }
+
+    if (argc < 2) {
+        return dump_log("chronoTask.binlog");
+    }
+
+    int result = 0;
+    for (int i = 1; i < argc; i++) {
+        if (dump_log(argv[i]) != 0) {
+            result = 1;
+        }
+    }
+    return result;
+}
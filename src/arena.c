@@ -0,0 +1,113 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_INITIAL_CAPACITY 4096
+#define INTERN_INITIAL_CAPACITY 256
+
+void arena_init(Arena *arena) {
+    memset(arena, 0, sizeof(*arena));
+}
+
+void arena_free(Arena *arena) {
+    free(arena->data);
+    free(arena->intern_slots);
+    arena_init(arena);
+}
+
+static int arena_reserve(Arena *arena, size_t size) {
+    if (size <= arena->capacity) {
+        return 1;
+    }
+
+    size_t capacity = arena->capacity ? arena->capacity : ARENA_INITIAL_CAPACITY;
+    while (capacity < size) {
+        capacity *= 2;
+    }
+    if (capacity > ARENA_INVALID) {
+        return 0;
+    }
+
+    char *data = realloc(arena->data, capacity);
+    if (!data) {
+        return 0;
+    }
+    arena->data = data;
+    arena->capacity = capacity;
+    return 1;
+}
+
+uint32_t arena_alloc(Arena *arena, size_t size, size_t align) {
+    size_t offset = (arena->used + align - 1) & ~(align - 1);
+    if (!arena_reserve(arena, offset + size)) {
+        return ARENA_INVALID;
+    }
+    memset(arena->data + arena->used, 0, offset + size - arena->used);
+    arena->used = offset + size;
+    return (uint32_t)offset;
+}
+
+uint32_t arena_push(Arena *arena, const void *data, size_t size, size_t align) {
+    uint32_t offset = arena_alloc(arena, size, align);
+    if (offset != ARENA_INVALID && size > 0) {
+        memcpy(arena->data + offset, data, size);
+    }
+    return offset;
+}
+
+static uint32_t hash_string(const char *string, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)string[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static int grow_intern_table(Arena *arena) {
+    size_t capacity = arena->intern_capacity ? arena->intern_capacity * 2 : INTERN_INITIAL_CAPACITY;
+    uint32_t *slots = calloc(capacity, sizeof(uint32_t));
+    if (!slots) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < arena->intern_capacity; i++) {
+        uint32_t entry = arena->intern_slots[i];
+        if (entry == 0) {
+            continue;
+        }
+        const char *string = arena->data + entry - 1;
+        size_t slot = hash_string(string, strlen(string)) & (capacity - 1);
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        slots[slot] = entry;
+    }
+
+    free(arena->intern_slots);
+    arena->intern_slots = slots;
+    arena->intern_capacity = capacity;
+    return 1;
+}
+
+uint32_t arena_intern(Arena *arena, const char *string) {
+    if ((arena->intern_count + 1) * 4 > arena->intern_capacity * 3 && !grow_intern_table(arena)) {
+        return ARENA_INVALID;
+    }
+
+    size_t length = strlen(string);
+    size_t slot = hash_string(string, length) & (arena->intern_capacity - 1);
+    while (arena->intern_slots[slot] != 0) {
+        const char *existing = arena->data + arena->intern_slots[slot] - 1;
+        if (strcmp(existing, string) == 0) {
+            return arena->intern_slots[slot] - 1;
+        }
+        slot = (slot + 1) & (arena->intern_capacity - 1);
+    }
+
+    uint32_t offset = arena_push(arena, string, length + 1, 1);
+    if (offset != ARENA_INVALID) {
+        arena->intern_slots[slot] = offset + 1;
+        arena->intern_count++;
+    }
+    return offset;
+}
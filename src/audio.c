@@ -1,61 +1,474 @@
 #include "audio.h"
 #include "error_report.h"
 #include "config.h"
+#include "startup.h"
+#include "timekeeper.h"
+#include "thread.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
-Mix_Chunk *notification_sound = NULL;
+#define AUDIO_FREQUENCY 44100
+#define AUDIO_FORMAT MIX_DEFAULT_FORMAT
+#define AUDIO_CHANNELS 2
+#define AUDIO_CHUNK_SIZE 2048
+#define AUDIO_OPEN_LEAD (2 * NSEC_PER_SEC)
+#define AUDIO_DRAIN_LIMIT_MS 5000
+#define AUDIO_PLAYBACK_POLL_MS 100
+#define SOUND_BANK_SIZE 32
+#define SOUND_NAME_MAX 256
 
-int initialize_audio() {
-    LOG_INFO("Initializing SDL audio subsystem");
-    if (SDL_Init(SDL_INIT_AUDIO) < 0) {
-        LOG_ERROR("SDL could not initialize! SDL Error: %s", SDL_GetError());
+typedef struct {
+    char path[PATH_MAX];
+    Uint8 *data;
+    Uint32 length;
+    int frequency;
+    Uint16 format;
+    int channels;
+    Mix_Chunk *chunk;
+    int in_use;
+} SoundEntry;
+
+static SoundEntry sound_bank[SOUND_BANK_SIZE];
+static int default_sound = -1;
+static char routine_sounds[SOUND_BANK_SIZE][SOUND_NAME_MAX];
+static int routine_sound_count = 0;
+static int routine_sounds_pending = 0;
+
+static int audio_device_open = 0;
+static int audio_frequency = AUDIO_FREQUENCY;
+static Uint16 audio_format = AUDIO_FORMAT;
+static int audio_channels = AUDIO_CHANNELS;
+static int64_t last_audio_use = 0;
+
+static pthread_t audio_thread;
+static int audio_thread_running = 0;
+static atomic_int audio_thread_done;
+static int startup_on_demand = 0;
+static char startup_sound[SOUND_NAME_MAX];
+
+static int decode_sound(SoundEntry *entry) {
+    SDL_AudioSpec spec;
+    Uint8 *wav_data;
+    Uint32 wav_length;
+    int64_t start = startup_now();
+
+    if (!SDL_LoadWAV(entry->path, &spec, &wav_data, &wav_length)) {
+        LOG_ERROR("Failed to decode sound %s! SDL Error: %s", entry->path, SDL_GetError());
         return 0;
     }
-    LOG_DEBUG("SDL audio subsystem initialized successfully");
 
-    LOG_INFO("Opening audio device");
-    if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0) {
-        LOG_ERROR("SDL_mixer could not initialize! SDL_mixer Error: %s", Mix_GetError());
+    SDL_AudioCVT cvt;
+    int needed = SDL_BuildAudioCVT(&cvt, spec.format, spec.channels, spec.freq,
+                                   audio_format, audio_channels, audio_frequency);
+    if (needed < 0) {
+        LOG_ERROR("Cannot convert %s to the device format! SDL Error: %s", entry->path, SDL_GetError());
+        SDL_FreeWAV(wav_data);
         return 0;
     }
-    LOG_DEBUG("Audio device opened successfully");
 
-    LOG_INFO("Loading notification sound file");
-    char* sound_path = get_config_path(config.notification_sound);
-    if (!sound_path) {
-        LOG_ERROR("Could not find notification sound file: %s", config.notification_sound);
+    cvt.len = wav_length;
+    cvt.buf = malloc((size_t)wav_length * (cvt.len_mult > 0 ? cvt.len_mult : 1));
+    if (!cvt.buf) {
+        SDL_FreeWAV(wav_data);
+        return 0;
+    }
+    memcpy(cvt.buf, wav_data, wav_length);
+    SDL_FreeWAV(wav_data);
+    if (needed > 0 && SDL_ConvertAudio(&cvt) < 0) {
+        LOG_ERROR("Failed to convert %s! SDL Error: %s", entry->path, SDL_GetError());
+        free(cvt.buf);
+        return 0;
+    }
+
+    free(entry->data);
+    entry->data = cvt.buf;
+    entry->length = needed > 0 ? (Uint32)cvt.len_cvt : wav_length;
+    entry->frequency = audio_frequency;
+    entry->format = audio_format;
+    entry->channels = audio_channels;
+    startup_phase("decode sound", start);
+    LOG_DEBUG("Decoded %s to %u bytes of device-format audio", entry->path, entry->length);
+    return 1;
+}
+
+static void release_chunk(SoundEntry *entry) {
+    if (entry->chunk != NULL) {
+        Mix_FreeChunk(entry->chunk);
+        entry->chunk = NULL;
+    }
+}
+
+static int attach_chunk(SoundEntry *entry) {
+    if (entry->chunk != NULL) {
+        return 1;
+    }
+    if (entry->frequency != audio_frequency || entry->format != audio_format ||
+        entry->channels != audio_channels) {
+        if (!decode_sound(entry)) {
+            return 0;
+        }
+    }
+
+    entry->chunk = Mix_QuickLoad_RAW(entry->data, entry->length);
+    if (entry->chunk == NULL) {
+        LOG_ERROR("Failed to wrap sound %s! SDL_mixer Error: %s", entry->path, Mix_GetError());
         return 0;
     }
+    return 1;
+}
+
+static void halt_chunk(const Mix_Chunk *chunk) {
+    int channels = Mix_AllocateChannels(-1);
+    for (int channel = 0; channel < channels; channel++) {
+        if (Mix_Playing(channel) && Mix_GetChunk(channel) == chunk) {
+            Mix_HaltChannel(channel);
+        }
+    }
+}
+
+static void free_sound(SoundEntry *entry) {
+    if (entry->chunk != NULL) {
+        halt_chunk(entry->chunk);
+        release_chunk(entry);
+    }
+    free(entry->data);
+    memset(entry, 0, sizeof(*entry));
+}
+
+static size_t sound_bank_bytes(int *count) {
+    size_t bytes = 0;
+    *count = 0;
+    for (int i = 0; i < SOUND_BANK_SIZE; i++) {
+        if (sound_bank[i].data) {
+            bytes += sound_bank[i].length;
+            (*count)++;
+        }
+    }
+    return bytes;
+}
+
+static int find_sound(const char *name) {
+    char path[PATH_MAX];
+    int free_slot = -1;
+
+    if (!get_config_path(name, path, sizeof(path))) {
+        LOG_ERROR("Could not find sound file: %s", name);
+        return -1;
+    }
+    for (int i = 0; i < SOUND_BANK_SIZE; i++) {
+        if (sound_bank[i].data && strcmp(sound_bank[i].path, path) == 0) {
+            return i;
+        }
+        if (!sound_bank[i].data && free_slot == -1) {
+            free_slot = i;
+        }
+    }
+    if (free_slot == -1) {
+        LOG_WARNING("Sound bank is full, cannot load %s", path);
+        return -1;
+    }
+
+    SoundEntry *entry = &sound_bank[free_slot];
+    snprintf(entry->path, sizeof(entry->path), "%s", path);
+    if (!decode_sound(entry)) {
+        memset(entry, 0, sizeof(*entry));
+        return -1;
+    }
+    if (audio_device_open) {
+        attach_chunk(entry);
+    }
+    return free_slot;
+}
+
+static int bank_sound(const char *name) {
+    char path[PATH_MAX];
 
-    notification_sound = Mix_LoadWAV(sound_path);
-    if (notification_sound == NULL) {
-        LOG_ERROR("Failed to load notification sound from %s! SDL_mixer Error: %s", sound_path, Mix_GetError());
+    if (name == NULL || name[0] == '\0') {
+        return default_sound;
+    }
+    if (get_config_path(name, path, sizeof(path))) {
+        for (int i = 0; i < SOUND_BANK_SIZE; i++) {
+            if (sound_bank[i].data && strcmp(sound_bank[i].path, path) == 0) {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+static int load_default_sound(const char *name) {
+    LOG_INFO("Loading notification sound file");
+    int index = find_sound(name);
+    if (index == -1) {
         return 0;
     }
-    LOG_DEBUG("Notification sound loaded successfully from %s", sound_path);
 
-    LOG_INFO("Audio initialized successfully");
+    int previous = default_sound;
+    default_sound = index;
+    if (previous != -1 && previous != index && !sound_bank[previous].in_use) {
+        free_sound(&sound_bank[previous]);
+    }
+    LOG_DEBUG("Notification sound loaded successfully from %s", sound_bank[index].path);
     return 1;
 }
 
-void play_notification_sound() {
-    if (notification_sound != NULL) {
-        if (Mix_PlayChannel(-1, notification_sound, 0) == -1) {
-            LOG_WARNING("Failed to play notification sound! SDL_mixer Error: %s", Mix_GetError());
+static void log_sound_bank(void) {
+    int count;
+    size_t bytes = sound_bank_bytes(&count);
+    LOG_INFO("Sound bank holds %d sounds in %.1f KB", count, bytes / 1024.0);
+}
+
+static void load_routine_sounds(void) {
+    routine_sounds_pending = 0;
+    for (int i = 0; i < SOUND_BANK_SIZE; i++) {
+        sound_bank[i].in_use = 0;
+    }
+    for (int i = 0; i < routine_sound_count; i++) {
+        int index = find_sound(routine_sounds[i]);
+        if (index != -1) {
+            sound_bank[index].in_use = 1;
+        }
+    }
+    for (int i = 0; i < SOUND_BANK_SIZE; i++) {
+        if (sound_bank[i].data && !sound_bank[i].in_use && i != default_sound) {
+            LOG_DEBUG("Dropping unused sound %s", sound_bank[i].path);
+            free_sound(&sound_bank[i]);
+        }
+    }
+    log_sound_bank();
+}
+
+static int open_audio_device(void) {
+    if (audio_device_open) {
+        return 1;
+    }
+
+    int64_t start = now_ns();
+    int64_t phase_start = startup_now();
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+        LOG_ERROR("SDL could not initialize! SDL Error: %s", SDL_GetError());
+        return 0;
+    }
+    startup_phase("SDL audio init", phase_start);
+    phase_start = startup_now();
+    if (Mix_OpenAudio(AUDIO_FREQUENCY, AUDIO_FORMAT, AUDIO_CHANNELS, AUDIO_CHUNK_SIZE) < 0) {
+        LOG_ERROR("SDL_mixer could not initialize! SDL_mixer Error: %s", Mix_GetError());
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        return 0;
+    }
+    if (!Mix_QuerySpec(&audio_frequency, &audio_format, &audio_channels)) {
+        audio_frequency = AUDIO_FREQUENCY;
+        audio_format = AUDIO_FORMAT;
+        audio_channels = AUDIO_CHANNELS;
+    }
+    startup_phase("open audio device", phase_start);
+    audio_device_open = 1;
+    last_audio_use = now_ns();
+    for (int i = 0; i < SOUND_BANK_SIZE; i++) {
+        if (sound_bank[i].data) {
+            attach_chunk(&sound_bank[i]);
         }
+    }
+    LOG_DEBUG("Audio device opened in %.1f ms", (now_ns() - start) / 1e6);
+    return 1;
+}
+
+static void close_audio_device(void) {
+    if (!audio_device_open) {
+        return;
+    }
+    Mix_HaltChannel(-1);
+    for (int i = 0; i < SOUND_BANK_SIZE; i++) {
+        release_chunk(&sound_bank[i]);
+    }
+    Mix_CloseAudio();
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    audio_device_open = 0;
+    LOG_DEBUG("Audio device closed");
+}
+
+static void *run_audio_startup(void *arg) {
+    (void)arg;
+    int64_t start = startup_now();
+    startup_set_thread("audio");
+
+    int ok = load_default_sound(startup_sound);
+    if (!startup_on_demand) {
+        ok = open_audio_device() && ok;
+    }
+    if (ok) {
+        LOG_INFO("Audio initialized successfully%s", startup_on_demand ? ", device opens on demand" : "");
     } else {
+        LOG_WARNING("Failed to initialize audio. ChronoTask will continue without sound.");
+    }
+    startup_task_end("audio", start);
+    atomic_store_explicit(&audio_thread_done, 1, memory_order_release);
+    return NULL;
+}
+
+static void wait_for_audio(void) {
+    if (audio_thread_running) {
+        pthread_join(audio_thread, NULL);
+        audio_thread_running = 0;
+    }
+}
+
+static int audio_thread_busy(void) {
+    if (!audio_thread_running) {
+        return 0;
+    }
+    if (!atomic_load_explicit(&audio_thread_done, memory_order_acquire)) {
+        return 1;
+    }
+    wait_for_audio();
+    return 0;
+}
+
+void start_audio(void) {
+    snprintf(startup_sound, sizeof(startup_sound), "%s", config.notification_sound);
+    startup_on_demand = config.audio_on_demand;
+    atomic_store(&audio_thread_done, 0);
+    startup_task_begin();
+
+    int error = start_worker_thread(&audio_thread, run_audio_startup, NULL);
+
+    if (error != 0) {
+        LOG_WARNING("Failed to start audio thread, initializing audio inline: %s", strerror(error));
+        run_audio_startup(NULL);
+        return;
+    }
+    audio_thread_running = 1;
+}
+
+int load_notification_sound() {
+    wait_for_audio();
+    return load_default_sound(config.notification_sound);
+}
+
+static void add_routine_sound(const char *name) {
+    if (name[0] == '\0') {
+        return;
+    }
+    for (int i = 0; i < routine_sound_count; i++) {
+        if (strcmp(routine_sounds[i], name) == 0) {
+            return;
+        }
+    }
+    if (routine_sound_count == SOUND_BANK_SIZE) {
+        LOG_WARNING("Too many sounds in one routine, %s will play the notification sound instead", name);
+        return;
+    }
+    snprintf(routine_sounds[routine_sound_count++], SOUND_NAME_MAX, "%s", name);
+}
+
+void audio_use_routine(const Routine *routine) {
+    routine_sound_count = 0;
+    add_routine_sound(routine->sound);
+    add_routine_sound(routine->complete_sound);
+    add_routine_sound(routine->warning_sound);
+    for (int i = 0; i < routine->task_count; i++) {
+        add_routine_sound(routine->strings + routine->task_sounds[i]);
+    }
+    routine_sounds_pending = 1;
+}
+
+void play_sound(const char *name) {
+    if (audio_thread_busy()) {
+        LOG_WARNING("Audio is still initializing, skipping notification sound");
+        return;
+    }
+
+    int index = bank_sound(name);
+    if (index == -1) {
+        LOG_WARNING("Sound %s is not loaded, playing the notification sound instead", name);
+        index = default_sound;
+    }
+    if (index == -1) {
         LOG_WARNING("Attempted to play notification sound, but it's not loaded");
+        return;
+    }
+    if (!audio_device_open) {
+        LOG_DEBUG("Audio device was not warm, opening it for playback");
+        if (!open_audio_device()) {
+            return;
+        }
+    }
+
+    if (!attach_chunk(&sound_bank[index]) || Mix_PlayChannel(-1, sound_bank[index].chunk, 0) == -1) {
+        LOG_WARNING("Failed to play sound %s! SDL_mixer Error: %s", sound_bank[index].path, Mix_GetError());
+    }
+    last_audio_use = now_ns();
+}
+
+void play_notification_sound() {
+    play_sound(NULL);
+}
+
+static int64_t audio_idle_deadline(void) {
+    return last_audio_use + (int64_t)config.audio_idle_timeout * NSEC_PER_SEC;
+}
+
+void audio_update(int paused, int64_t next_sound, const char *next_sound_name) {
+    if (audio_thread_busy()) {
+        return;
+    }
+    if (routine_sounds_pending) {
+        load_routine_sounds();
+    }
+    if (!config.audio_on_demand) {
+        return;
+    }
+
+    int64_t now = now_ns();
+    if (!paused && next_sound <= AUDIO_OPEN_LEAD &&
+        (bank_sound(next_sound_name) != -1 || default_sound != -1)) {
+        if (!audio_device_open) {
+            LOG_DEBUG("Warming up audio device ahead of the next sound");
+            open_audio_device();
+        }
+        last_audio_use = now;
+        return;
+    }
+
+    if (audio_device_open) {
+        if (Mix_Playing(-1) > 0) {
+            last_audio_use = now;
+        } else if (now >= audio_idle_deadline()) {
+            close_audio_device();
+        }
     }
 }
 
+int audio_poll_timeout(void) {
+    if (audio_thread_busy() || !audio_device_open || !config.audio_on_demand) {
+        return -1;
+    }
+    if (Mix_Playing(-1) > 0) {
+        return AUDIO_PLAYBACK_POLL_MS;
+    }
+
+    int64_t wait = audio_idle_deadline() - now_ns();
+    if (wait <= 0) {
+        return 0;
+    }
+    return (int)((wait + 999999) / 1000000);
+}
+
 void cleanup_audio() {
     LOG_INFO("Cleaning up audio resources");
-    if (notification_sound != NULL) {
-        Mix_FreeChunk(notification_sound);
-        notification_sound = NULL;
+    wait_for_audio();
+    for (int waited = 0; audio_device_open && Mix_Playing(-1) > 0 && waited < AUDIO_DRAIN_LIMIT_MS; waited += 50) {
+        SDL_Delay(50);
     }
-    Mix_CloseAudio();
+    close_audio_device();
+    for (int i = 0; i < SOUND_BANK_SIZE; i++) {
+        free_sound(&sound_bank[i]);
+    }
+    default_sound = -1;
     SDL_Quit();
     LOG_DEBUG("Audio resources cleaned up");
 }
@@ -6,167 +6,335 @@
 #include "overlay.h"
 #include "audio.h"
 #include "socket.h"
+#include "timekeeper.h"
+#include "status_page.h"
+#include "reload.h"
+#include "startup.h"
+#include "stats.h"
+#include "metrics.h"
 #include <signal.h>
-#include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <sys/timerfd.h>
 
 volatile sig_atomic_t keep_running = 1;
-int paused = 0;
-time_t pause_start_time = 0;
-time_t total_pause_duration = 0;
-time_t task_start_time = 0;
+static CommandServer server;
+static int state_changed = 0;
 
 void handle_sigint(int sig) {
     (void)sig;
     keep_running = 0;
 }
 
-void handle_command(int client_socket, const char* cmd) {
-    char response[BUFFER_SIZE];
+static void arm_tick_timer(int timer_fd) {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
 
+    if (!is_task_paused()) {
+        int64_t next_tick = get_next_tick_time();
+        its.it_value.tv_sec = next_tick / NSEC_PER_SEC;
+        its.it_value.tv_nsec = next_tick % NSEC_PER_SEC;
+        if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) {
+            its.it_value.tv_nsec = 1;
+        }
+    }
+
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL) == -1) {
+        LOG_ERROR("Failed to arm tick timer: %s", strerror(errno));
+    }
+}
+
+static int earliest_timeout(int a, int b) {
+    if (a < 0) {
+        return b;
+    }
+    if (b < 0) {
+        return a;
+    }
+    return a < b ? a : b;
+}
+
+static void drain_tick_timer(int timer_fd) {
+    uint64_t expirations;
+    if (read(timer_fd, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN) {
+        LOG_ERROR("Failed to read tick timer: %s", strerror(errno));
+    }
+}
+
+static void format_status_record(Buffer *record) {
+    Routine *routine = &routine_list.routines[current_routine];
+    buffer_printf(record, "%s %d %d/%d %s",
+                  is_task_paused() ? "paused" : "running",
+                  ns_to_display_seconds(get_task_remaining_ns()),
+                  get_current_task_index() + 1, routine->task_count,
+                  get_current_task_name());
+}
+
+static void publish_status(Subscription level) {
+    Buffer record = {0};
+    format_status_record(&record);
+    server_broadcast(&server, level, record.data, record.len);
+    buffer_free(&record);
+    if (level == SUBSCRIBE_CHANGES) {
+        metrics_update();
+    }
+}
+
+static void handle_config_command(const char *args, Buffer *response) {
+    char value[512];
+    char error[128];
+    char name[64];
+    const ConfigKey *key;
+
+    while (*args == ' ') {
+        args++;
+    }
+
+    if (*args == '\0') {
+        for (int i = 0; i < config_key_count; i++) {
+            config_format_value(&config, &config_keys[i], value, sizeof(value));
+            buffer_printf(response, "%s%s: %s", i > 0 ? "\n" : "", config_keys[i].name, value);
+        }
+    } else if (strncmp(args, "get ", 4) == 0) {
+        if (!(key = config_find_key(args + 4))) {
+            buffer_printf(response, "Unknown configuration key: %s", args + 4);
+            return;
+        }
+        config_format_value(&config, key, value, sizeof(value));
+        buffer_printf(response, "%s: %s", key->name, value);
+    } else if (strncmp(args, "set ", 4) == 0) {
+        const char *separator = strchr(args + 4, ' ');
+        size_t len = separator ? (size_t)(separator - (args + 4)) : 0;
+        if (len == 0 || len >= sizeof(name)) {
+            buffer_printf(response, "Usage: config set <key> <value>");
+            return;
+        }
+        memcpy(name, args + 4, len);
+        name[len] = '\0';
+        if (!(key = config_find_key(name))) {
+            buffer_printf(response, "Unknown configuration key: %s", name);
+            return;
+        }
+        if (key->apply == CONFIG_RESTART) {
+            buffer_printf(response, "%s only takes effect after a restart, not changed", key->name);
+            return;
+        }
+
+        ChronoTaskConfig fresh = config;
+        if (!config_set_value(&fresh, key, separator + 1, error, sizeof(error))) {
+            buffer_printf(response, "Invalid value for %s: %s", key->name, error);
+            return;
+        }
+        reload_apply_config(&fresh);
+        config_format_value(&config, key, value, sizeof(value));
+        buffer_printf(response, "%s: %s", key->name, value);
+    } else {
+        buffer_printf(response, "Usage: config [get <key> | set <key> <value>]");
+    }
+}
+
+static void handle_stats_command(const char *args, Buffer *response) {
+    if (*args == '\0') {
+        stats_format_text(response);
+    } else if (strcmp(args, " json") == 0) {
+        stats_format_json(response);
+    } else {
+        buffer_printf(response, "Usage: stats [json]");
+    }
+}
+
+static Subscription run_command(const char* cmd, Buffer *response) {
     if (strcmp(cmd, "pause") == 0) {
-        if (!paused) {
-            paused = 1;
-            pause_start_time = time(NULL);
-            strcpy(response, "Task paused");
+        if (pause_current_task()) {
+            metrics_task_paused();
+            buffer_printf(response, "Task paused");
+            state_changed = 1;
         } else {
-            strcpy(response, "Task already paused");
+            buffer_printf(response, "Task already paused");
         }
     } else if (strcmp(cmd, "resume") == 0) {
-        if (paused) {
-            paused = 0;
-            total_pause_duration += difftime(time(NULL), pause_start_time);
-            pause_start_time = 0;
-            strcpy(response, "Task resumed");
+        if (resume_current_task()) {
+            buffer_printf(response, "Task resumed");
+            state_changed = 1;
         } else {
-            strcpy(response, "Task already running");
+            buffer_printf(response, "Task already running");
         }
     } else if (strcmp(cmd, "next") == 0) {
-        int moved = move_to_next_task();
-        if (moved) {
-            task_start_time = time(NULL);
-            total_pause_duration = 0;
+        if (move_to_next_task()) {
+            state_changed = 1;
         }
-        snprintf(response, BUFFER_SIZE, "Moved to next task: %s", get_current_task_name());
+        buffer_printf(response, "Moved to next task: %s", get_current_task_name());
     } else if (strcmp(cmd, "previous") == 0) {
         move_to_previous_task();
-        task_start_time = time(NULL);
-        total_pause_duration = 0;
-        snprintf(response, BUFFER_SIZE, "Moved to previous task: %s", get_current_task_name());
+        state_changed = 1;
+        buffer_printf(response, "Moved to previous task: %s", get_current_task_name());
     } else if (strncmp(cmd, "extend ", 7) == 0) {
         int minutes = atoi(cmd + 7);
         extend_current_task(minutes * 60);
-        snprintf(response, BUFFER_SIZE, "Extended task by %d minutes", minutes);
+        metrics_task_extended(minutes * 60);
+        state_changed = 1;
+        buffer_printf(response, "Extended task by %d minutes", minutes);
     } else if (strcmp(cmd, "status") == 0) {
-        time_t now = time(NULL);
-        int elapsed = difftime(now, get_task_start_time()) - total_pause_duration;
-        int remaining = get_current_task_duration() - elapsed;
-        snprintf(response, BUFFER_SIZE, "Current task: %s, Time remaining: %d seconds, Status: %s",
-                get_current_task_name(), remaining, paused ? "Paused" : "Running");
+        int remaining = ns_to_display_seconds(get_task_remaining_ns());
+        buffer_printf(response, "Current task: %s, Time remaining: %d seconds, Status: %s",
+                get_current_task_name(), remaining, is_task_paused() ? "Paused" : "Running");
+    } else if (strcmp(cmd, "subscribe") == 0 || strcmp(cmd, "subscribe tick") == 0) {
+        format_status_record(response);
+        return strcmp(cmd, "subscribe") == 0 ? SUBSCRIBE_CHANGES : SUBSCRIBE_TICKS;
+    } else if (strcmp(cmd, "config") == 0 || strncmp(cmd, "config ", 7) == 0) {
+        handle_config_command(cmd + 6, response);
+    } else if (strcmp(cmd, "stats") == 0 || strncmp(cmd, "stats ", 6) == 0) {
+        handle_stats_command(cmd + 5, response);
     } else if (strcmp(cmd, "abort") == 0) {
-        strcpy(response, "Terminating ChronoTask");
-        send_message(client_socket, response);
+        buffer_printf(response, "Terminating ChronoTask");
         keep_running = 0;
-        return;
     } else {
-        strcpy(response, "Unknown command");
+        buffer_printf(response, "Unknown command");
     }
 
-    send_message(client_socket, response);
+    return SUBSCRIBE_NONE;
 }
 
-int run_chronotask(const char* config_file) {
-    LOG_INFO("Loading configuration...");
-    if (!load_config(config_file)) {
-        LOG_FATAL("Failed to load configuration from %s", config_file);
-    }
-
-    LOG_INFO("Initializing routines...");
-    if (!initialize_tasks()) {
-        LOG_FATAL("Failed to initialize routines");
-    }
-
-    LOG_INFO("Initializing audio...");
-    if (!initialize_audio()) {
-        LOG_WARNING("Failed to initialize audio. ChronoTask will continue without sound.");
-    }
+Subscription handle_command(const char* cmd, Buffer *response) {
+    int64_t start = now_ns();
+    Subscription subscription = run_command(cmd, response);
+    stats_command(cmd, now_ns() - start);
+    return subscription;
+}
 
-    LOG_INFO("Opening display");
-    if (!initialize_display()) {
-        LOG_FATAL("Failed to initialize display");
-    }
+int run_chronotask(const char* config_file) {
+    status_page_create();
 
     LOG_INFO("Creating transparent window...");
     create_transparent_window();
+    startup_stage("window");
 
     LOG_INFO("Creating command socket...");
-    int command_socket = create_socket();
-    if (command_socket == -1) {
+    if (!server_init(&server, config.socket_backlog, config.client_idle_timeout)) {
         LOG_FATAL("Failed to create command socket");
     }
+    startup_stage("socket");
+
+    LOG_INFO("Watching configuration for changes...");
+    reload_init(config_file);
+    startup_stage("file watches");
+
+    if (!initialize_overlay_resources()) {
+        LOG_WARNING("Failed to prepare overlay resources, retrying on the first frame");
+    }
+    startup_stage("font");
 
-    int flags = fcntl(command_socket, F_GETFL, 0);
-    fcntl(command_socket, F_SETFL, flags | O_NONBLOCK);
+    int timer_fd = timerfd_create(get_timekeeping_clock(), TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd == -1) {
+        LOG_FATAL("Failed to create tick timer: %s", strerror(errno));
+    }
 
     signal(SIGINT, handle_sigint);
 
-    task_start_time = time(NULL);
-    LOG_INFO("Entering main loop...");
+    audio_use_routine(&routine_list.routines[current_routine]);
 
-    Routine *current_routine_ptr = &routine_list.routines[current_routine];
+    stats_loop_start();
+    metrics_update();
+    LOG_INFO("Entering main loop...");
 
     while (keep_running) {
-        time_t current_time = time(NULL);
-        time_t elapsed_time;
-
-        elapsed_time = paused ?
-            difftime(pause_start_time, task_start_time) - total_pause_duration :
-            difftime(current_time, task_start_time) - total_pause_duration;
+        int64_t remaining = get_task_remaining_ns();
+        stats_loop_iteration();
 
-        draw_overlay(paused, elapsed_time);
         handle_x11_events();
+        draw_overlay(is_task_paused(), ns_to_display_seconds(remaining));
+        startup_first_frame();
+        audio_update(is_task_paused(), get_next_sound_ns(), get_next_sound_name());
 
-        int client_socket = accept_connection(command_socket);
-        if (client_socket != -1) {
-            char buffer[BUFFER_SIZE];
-            int bytes_read = receive_message(client_socket, buffer, BUFFER_SIZE);
-            if (bytes_read > 0) {
-                handle_command(client_socket, buffer);
-            }
-            close(client_socket);
+        if (take_task_warning()) {
+            LOG_INFO("Task ending soon: %s", get_current_task_name());
+            play_sound(routine_list.routines[current_routine].warning_sound);
         }
 
-        if (!paused && elapsed_time >= get_current_task_duration()) {
+        if (!is_task_paused() && remaining <= 0) {
+            const char *sound = get_current_task_sound();
             LOG_INFO("Task completed: %s", get_current_task_name());
-            play_notification_sound();
-
-            if (!move_to_next_task()) {
-                if (current_routine_ptr->inf_loop || --current_routine_ptr->loop > 0) {
-                    reset_routine();
-                } else {
-                    LOG_INFO("Routine completed.");
-                    break;
-                }
+            metrics_task_completed();
+
+            if (!finish_current_task() && !start_next_routine_loop()) {
+                const char *complete_sound = routine_list.routines[current_routine].complete_sound;
+                play_sound(complete_sound[0] != '\0' ? complete_sound : sound);
+                LOG_INFO("Routine completed.");
+                break;
             }
+            play_sound(sound);
 
-            task_start_time = time(NULL);
-            total_pause_duration = 0;
             LOG_INFO("Starting next task: %s", get_current_task_name());
+            publish_status(SUBSCRIBE_CHANGES);
+            continue;
+        }
+
+        if (x11_events_queued()) {
+            continue;
+        }
+
+        arm_tick_timer(timer_fd);
+
+        struct pollfd fds[2 + RELOAD_POLL_FDS + 1 + MAX_CLIENTS];
+        fds[0] = (struct pollfd){ .fd = get_display_fd(), .events = POLLIN };
+        fds[1] = (struct pollfd){ .fd = timer_fd, .events = POLLIN };
+        int reload_fds = reload_fill_pollfds(fds + 2, RELOAD_POLL_FDS);
+        struct pollfd *server_pollfds = fds + 2 + reload_fds;
+        int server_fds = server_fill_pollfds(&server, server_pollfds, 1 + MAX_CLIENTS);
+
+        int timeout = earliest_timeout(server_poll_timeout(&server), audio_poll_timeout());
+        if (poll(fds, 2 + reload_fds + server_fds, timeout) == -1) {
+            if (errno != EINTR) {
+                LOG_ERROR("poll failed: %s", strerror(errno));
+            }
+            continue;
         }
+        stats_wakeup();
 
-        struct timespec ts;
-        ts.tv_sec = 0;
-        ts.tv_nsec = 10000000L;
-        nanosleep(&ts, NULL);
+        if (fds[1].revents & POLLIN) {
+            drain_tick_timer(timer_fd);
+            publish_status(SUBSCRIBE_TICKS);
+        }
+
+        if (reload_handle_events(fds + 2, reload_fds)) {
+            audio_use_routine(&routine_list.routines[current_routine]);
+            state_changed = 1;
+        }
+
+        server_handle_events(&server, server_pollfds, server_fds);
+        server_process_commands(&server, handle_command);
+
+        if (state_changed) {
+            state_changed = 0;
+            publish_status(SUBSCRIBE_CHANGES);
+        }
     }
 
     LOG_INFO("ChronoTask shutting down.");
+    LOG_INFO("Main loop woke up %lu times in %lld seconds", runtime_stats.wakeups,
+             (long long)((now_ns() - runtime_stats.loop_start) / NSEC_PER_SEC));
+
+    OverlayStats overlay_stats;
+    get_overlay_stats(&overlay_stats);
+    LOG_INFO("Overlay: %lu frames, %lu X requests, %lu frames with round-trips",
+             overlay_stats.frames, overlay_stats.requests, overlay_stats.round_trips);
+    LOG_INFO("Overlay text cache: %lu hits, %lu misses", overlay_stats.cache_hits, overlay_stats.cache_misses);
+
+    LogStats log_stats;
+    get_log_stats(&log_stats);
+    LOG_INFO("Logger: %lu messages written, %lu dropped", log_stats.written, log_stats.dropped);
 
+    metrics_cleanup();
+    reload_cleanup();
+    cleanup_overlay_resources();
     cleanup_display();
     cleanup_audio();
-    close(command_socket);
-    unlink(SOCKET_PATH);
+    close(timer_fd);
+    server_close(&server);
+    status_page_destroy();
 
     return 0;
 }
@@ -1,16 +1,35 @@
 #include "config.h"
 #include "error_report.h"
+#include "config_hash.h"
+#include "startup.h"
 #include <yaml.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <strings.h>
+#include <errno.h>
+#include <limits.h>
+#include <stddef.h>
 #include <X11/Xft/Xft.h>
 #include <unistd.h>
 #include <pwd.h>
+#include <pthread.h>
 
 ChronoTaskConfig config;
 
-char* get_config_path(const char* filename) {
-    static char path[1024];
+#define CONFIG_PATH_CACHE_SIZE 16
+
+typedef struct {
+    char *filename;
+    char *path;
+} ConfigPathEntry;
+
+static ConfigPathEntry path_cache[CONFIG_PATH_CACHE_SIZE];
+static int path_cache_count = 0;
+static pthread_mutex_t path_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int probe_config_path(const char* filename, char *path, size_t size) {
+    char candidate[PATH_MAX];
     char* home = getenv("HOME");
 
     if (!home) {
@@ -19,55 +38,282 @@ char* get_config_path(const char* filename) {
             home = pw->pw_dir;
     }
 
+    const char *found = NULL;
     if (home) {
-        snprintf(path, sizeof(path), "%s/.config/chronotask/%s", home, filename);
-        if (access(path, F_OK) != -1) return path;
+        snprintf(candidate, sizeof(candidate), "%s/.config/chronotask/%s", home, filename);
+        if (access(candidate, F_OK) != -1) found = candidate;
+    }
+    if (!found) {
+        snprintf(candidate, sizeof(candidate), "/usr/local/etc/chronotask/%s", filename);
+        if (access(candidate, F_OK) != -1) found = candidate;
+    }
+    if (!found) {
+        snprintf(candidate, sizeof(candidate), "./%s", filename);
+        if (access(candidate, F_OK) != -1) found = candidate;
+    }
+    if (!found) {
+        return 0;
     }
 
-    snprintf(path, sizeof(path), "/usr/local/etc/chronotask/%s", filename);
-    if (access(path, F_OK) != -1) return path;
+    char resolved[PATH_MAX];
+    snprintf(path, size, "%s", realpath(found, resolved) ? resolved : found);
+    return 1;
+}
+
+int get_config_path(const char* filename, char *path, size_t size) {
+    pthread_mutex_lock(&path_cache_lock);
+    for (int i = 0; i < path_cache_count; i++) {
+        if (strcmp(path_cache[i].filename, filename) == 0) {
+            snprintf(path, size, "%s", path_cache[i].path);
+            pthread_mutex_unlock(&path_cache_lock);
+            return 1;
+        }
+    }
+    pthread_mutex_unlock(&path_cache_lock);
+
+    if (!probe_config_path(filename, path, size)) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&path_cache_lock);
+    if (path_cache_count < CONFIG_PATH_CACHE_SIZE) {
+        ConfigPathEntry *entry = &path_cache[path_cache_count];
+        entry->filename = strdup(filename);
+        entry->path = strdup(path);
+        if (entry->filename && entry->path) {
+            path_cache_count++;
+        } else {
+            free(entry->filename);
+            free(entry->path);
+        }
+    }
+    pthread_mutex_unlock(&path_cache_lock);
+    LOG_DEBUG("Resolved %s to %s", filename, path);
+    return 1;
+}
 
-    snprintf(path, sizeof(path), "./%s", filename);
-    if (access(path, F_OK) != -1) return path;
+static const char *validate_positive(const ConfigKey *key, const void *value) {
+    if (key->type == CONFIG_DOUBLE ? *(const double *)value <= 0 : *(const int *)value <= 0) {
+        return "must be greater than zero";
+    }
+    return NULL;
+}
 
+static const char *validate_non_negative(const ConfigKey *key, const void *value) {
+    if (key->type == CONFIG_DOUBLE ? *(const double *)value < 0 : *(const int *)value < 0) {
+        return "must not be negative";
+    }
     return NULL;
 }
 
-Color parse_color(const char* color_str) {
-    Color color = {0, 0, 0};
+static const char *validate_not_empty(const ConfigKey *key, const void *value) {
+    (void)key;
+    return *(const char *)value == '\0' ? "must not be empty" : NULL;
+}
+
+#define CONFIG_KEY(name, type, default_value, validator, apply) \
+    { #name, type, offsetof(ChronoTaskConfig, name), sizeof(((ChronoTaskConfig *)0)->name), default_value, validator, apply },
+const ConfigKey config_keys[] = {
+#include "config_keys.def"
+};
+#undef CONFIG_KEY
+
+const int config_key_count = sizeof(config_keys) / sizeof(config_keys[0]);
+
+static const struct {
+    const char *name;
+    int weight;
+} font_weights[] = {
+    { "Thin", FC_WEIGHT_THIN },
+    { "Light", XFT_WEIGHT_LIGHT },
+    { "Normal", FC_WEIGHT_NORMAL },
+    { "Medium", XFT_WEIGHT_MEDIUM },
+    { "Bold", XFT_WEIGHT_BOLD },
+    { "Black", XFT_WEIGHT_BLACK },
+    { "Heavy", FC_WEIGHT_HEAVY },
+};
+
+static const char *horizontal_names[] = { "left", "center", "right", "custom" };
+static const char *vertical_names[] = { "top", "middle", "bottom", "custom" };
+
+static int parse_position(const char *value, const char **names, int count) {
+    for (int i = 0; i < count - 1; i++) {
+        if (strcasecmp(value, names[i]) == 0) {
+            return i;
+        }
+    }
+    return count - 1;
+}
+
+const ConfigKey *config_find_key(const char *name) {
+    int index = config_hash_slots[config_hash(name)];
+    if (index < 0 || strcmp(config_keys[index].name, name) != 0) {
+        return NULL;
+    }
+    return &config_keys[index];
+}
+
+int config_set_value(ChronoTaskConfig *target, const ConfigKey *key, const char *value,
+                     char *error, size_t error_size) {
+    union {
+        int i;
+        double d;
+        bool b;
+        Color c;
+    } parsed;
+    const void *result = &parsed;
     unsigned int r, g, b;
-    if (sscanf(color_str, "#%02x%02x%02x", &r, &g, &b) == 3) {
-        color.r = r;
-        color.g = g;
-        color.b = b;
+    char extra;
+    char *end;
+    size_t i;
+
+    if (value[0] == '\0' && key->type != CONFIG_STRING) {
+        value = key->default_value;
+    }
+
+    memset(&parsed, 0, sizeof(parsed));
+    switch (key->type) {
+        case CONFIG_STRING:
+            if (strlen(value) >= key->size) {
+                snprintf(error, error_size, "longer than %zu characters", key->size - 1);
+                return 0;
+            }
+            result = value;
+            break;
+        case CONFIG_INT: {
+            errno = 0;
+            long number = strtol(value, &end, 10);
+            if (end == value || *end != '\0' || errno != 0 || number < INT_MIN || number > INT_MAX) {
+                snprintf(error, error_size, "expected an integer");
+                return 0;
+            }
+            parsed.i = number;
+            break;
+        }
+        case CONFIG_DOUBLE:
+            parsed.d = strtod(value, &end);
+            if (end == value || *end != '\0') {
+                snprintf(error, error_size, "expected a number");
+                return 0;
+            }
+            break;
+        case CONFIG_BOOL:
+            if (strcasecmp(value, "true") != 0 && strcasecmp(value, "false") != 0) {
+                snprintf(error, error_size, "expected true or false");
+                return 0;
+            }
+            parsed.b = strcasecmp(value, "true") == 0;
+            break;
+        case CONFIG_COLOR:
+            if (sscanf(value, "#%02x%02x%02x%c", &r, &g, &b, &extra) != 3 || strlen(value) != 7) {
+                snprintf(error, error_size, "expected a color like #RRGGBB");
+                return 0;
+            }
+            parsed.c = (Color){ r, g, b };
+            break;
+        case CONFIG_FONT_WEIGHT:
+            for (i = 0; i < sizeof(font_weights) / sizeof(font_weights[0]); i++) {
+                if (strcasecmp(value, font_weights[i].name) == 0) {
+                    break;
+                }
+            }
+            if (i == sizeof(font_weights) / sizeof(font_weights[0])) {
+                snprintf(error, error_size, "expected Thin, Light, Normal, Medium, Bold, Black or Heavy");
+                return 0;
+            }
+            parsed.i = font_weights[i].weight;
+            break;
+        case CONFIG_HPOS:
+            parsed.i = parse_position(value, horizontal_names, H_CUSTOM + 1);
+            break;
+        case CONFIG_VPOS:
+            parsed.i = parse_position(value, vertical_names, V_CUSTOM + 1);
+            break;
+    }
+
+    const char *problem = key->validate ? key->validate(key, result) : NULL;
+    if (problem) {
+        snprintf(error, error_size, "%s", problem);
+        return 0;
+    }
+
+    char *field = (char *)target + key->offset;
+    if (key->type == CONFIG_STRING) {
+        memset(field, 0, key->size);
+        memcpy(field, value, strlen(value));
     } else {
-        LOG_WARNING("Invalid color format: %s. Using default (black).", color_str);
+        memcpy(field, result, key->size);
     }
-    return color;
+    return 1;
 }
 
-HorizontalPosition parse_horizontal_position(const char* pos_str) {
-    if (strcasecmp(pos_str, "left") == 0) return H_LEFT;
-    if (strcasecmp(pos_str, "center") == 0) return H_CENTER;
-    if (strcasecmp(pos_str, "right") == 0) return H_RIGHT;
-    return H_CUSTOM;
+void config_format_value(const ChronoTaskConfig *source, const ConfigKey *key, char *buffer, size_t size) {
+    const char *field = (const char *)source + key->offset;
+    const Color *color = (const Color *)field;
+    int number = 0;
+
+    if (key->size == sizeof(int)) {
+        memcpy(&number, field, sizeof(int));
+    }
+
+    switch (key->type) {
+        case CONFIG_STRING:
+            snprintf(buffer, size, "\"%s\"", field);
+            break;
+        case CONFIG_INT:
+            snprintf(buffer, size, "%d", number);
+            break;
+        case CONFIG_DOUBLE:
+            snprintf(buffer, size, "%g", *(const double *)field);
+            break;
+        case CONFIG_BOOL:
+            snprintf(buffer, size, "%s", *(const bool *)field ? "true" : "false");
+            break;
+        case CONFIG_COLOR:
+            snprintf(buffer, size, "\"#%02X%02X%02X\"", color->r, color->g, color->b);
+            break;
+        case CONFIG_FONT_WEIGHT:
+            snprintf(buffer, size, "%d", number);
+            for (size_t i = 0; i < sizeof(font_weights) / sizeof(font_weights[0]); i++) {
+                if (font_weights[i].weight == number) {
+                    snprintf(buffer, size, "\"%s\"", font_weights[i].name);
+                    break;
+                }
+            }
+            break;
+        case CONFIG_HPOS:
+            snprintf(buffer, size, "\"%s\"", horizontal_names[number >= 0 && number <= H_CUSTOM ? number : H_CUSTOM]);
+            break;
+        case CONFIG_VPOS:
+            snprintf(buffer, size, "\"%s\"", vertical_names[number >= 0 && number <= V_CUSTOM ? number : V_CUSTOM]);
+            break;
+    }
 }
 
-VerticalPosition parse_vertical_position(const char* pos_str) {
-    if (strcasecmp(pos_str, "top") == 0) return V_TOP;
-    if (strcasecmp(pos_str, "middle") == 0) return V_MIDDLE;
-    if (strcasecmp(pos_str, "bottom") == 0) return V_BOTTOM;
-    return V_CUSTOM;
+void config_set_defaults(ChronoTaskConfig *target) {
+    char error[128];
+
+    memset(target, 0, sizeof(*target));
+    for (int i = 0; i < config_key_count; i++) {
+        if (!config_set_value(target, &config_keys[i], config_keys[i].default_value, error, sizeof(error))) {
+            LOG_ERROR("Invalid default for %s: %s", config_keys[i].name, error);
+        }
+    }
 }
 
 int load_config(const char* filename) {
-    char* config_path = get_config_path(filename);
-    LOG_INFO("Holy path: %s", config_path);
-    if (!config_path) {
+    char config_path[PATH_MAX];
+    if (!get_config_path(filename, config_path, sizeof(config_path))) {
         LOG_ERROR("Could not find configuration file: %s", filename);
         return 0;
     }
+    LOG_INFO("Loading configuration from %s", config_path);
 
+    return load_config_file(config_path, &config);
+}
+
+int load_config_file(const char* config_path, ChronoTaskConfig *target) {
+    int64_t start = startup_now();
     FILE *file = fopen(config_path, "r");
     if (!file) {
         LOG_ERROR("Failed to open config file: %s", config_path);
@@ -77,11 +323,6 @@ int load_config(const char* filename) {
     yaml_parser_t parser;
     yaml_event_t event;
 
-    if (!file) {
-        LOG_ERROR("Failed to open config file: %s", filename);
-        return 0;
-    }
-
     if (!yaml_parser_initialize(&parser)) {
         LOG_ERROR("Failed to initialize YAML parser");
         fclose(file);
@@ -89,8 +330,10 @@ int load_config(const char* filename) {
     }
 
     yaml_parser_set_input_file(&parser, file);
+    config_set_defaults(target);
 
     char current_key[64] = "";
+    char error[128];
 
     do {
         if (!yaml_parser_parse(&parser, &event)) {
@@ -106,66 +349,14 @@ int load_config(const char* filename) {
                     strncpy(current_key, (char*)event.data.scalar.value, sizeof(current_key) - 1);
                     current_key[sizeof(current_key) - 1] = '\0';
                 } else {
-                    if (strcmp(current_key, "notification_sound") == 0) {
-                        strncpy(config.notification_sound, (char*)event.data.scalar.value, sizeof(config.notification_sound) - 1);
-                        config.notification_sound[sizeof(config.notification_sound) - 1] = '\0';
-                        LOG_DEBUG("Loaded notification_sound: %s", config.notification_sound);
-                    } else if (strcmp(current_key, "overlay_x") == 0) {
-                        config.overlay_x = atoi((char*)event.data.scalar.value);
-                        LOG_DEBUG("Loaded overlay_x: %d", config.overlay_x);
-                    } else if (strcmp(current_key, "overlay_y") == 0) {
-                        config.overlay_y = atoi((char*)event.data.scalar.value);
-                        LOG_DEBUG("Loaded overlay_y: %d", config.overlay_y);
-                    } else if (strcmp(current_key, "font_size") == 0) {
-                        config.font_size = atof((char*)event.data.scalar.value);
-                        LOG_DEBUG("Loaded font_size: %.2f", config.font_size);
-                    } else if (strcmp(current_key, "font_name") == 0) {
-                        strncpy(config.font_name, (char*)event.data.scalar.value, sizeof(config.font_name) - 1);
-                        config.font_name[sizeof(config.font_name) - 1] = '\0';
-                        LOG_DEBUG("Loaded font_name: %s", config.font_name);
-                    } else if (strcmp(current_key, "font_weight") == 0) {
-                        config.font_weight = string_to_font_weight((char*)event.data.scalar.value);
-                        LOG_DEBUG("Loaded font_weight: %d", config.font_weight);
-                    } else if (strcmp(current_key, "routines") == 0) {
-                        strncpy(config.routines, (char*)event.data.scalar.value, sizeof(config.routines) - 1);
-                        config.routines[sizeof(config.routines) - 1] = '\0';
-                        LOG_DEBUG("Loaded routines: %s", config.routines);
-                    } else if (strcmp(current_key, "text_color") == 0) {
-                        config.text_color = parse_color((char*)event.data.scalar.value);
-                        LOG_DEBUG("Loaded text_color: #%02x%02x%02x", config.text_color.r, config.text_color.g, config.text_color.b);
-                    } else if (strcmp(current_key, "stroke_color") == 0) {
-                        config.stroke_color = parse_color((char*)event.data.scalar.value);
-                        LOG_DEBUG("Loaded stroke_color: #%02x%02x%02x", config.stroke_color.r, config.stroke_color.g, config.stroke_color.b);
-                    } else if (strcmp(current_key, "target_screen") == 0) {
-                        config.target_screen = atoi((char*)event.data.scalar.value);
-                        LOG_DEBUG("Loaded target_screen: %d", config.target_screen);
-                    } else if (strcmp(current_key, "window_width") == 0) {
-                        config.window_width = atoi((char*)event.data.scalar.value);
-                        LOG_DEBUG("Loaded window_width: %d", config.window_width);
-                    } else if (strcmp(current_key, "window_height") == 0) {
-                        config.window_height = atoi((char*)event.data.scalar.value);
-                        LOG_DEBUG("Loaded target_screen: %d", config.window_height);
-                    }  else if (strcmp(current_key, "auto_x") == 0) {
-                        config.auto_x = parse_horizontal_position((char*)event.data.scalar.value);
-                        LOG_DEBUG("Loaded auto_x: %s", (char*)event.data.scalar.value);
-                    } else if (strcmp(current_key, "auto_y") == 0) {
-                        config.auto_y = parse_vertical_position((char*)event.data.scalar.value);
-                        LOG_DEBUG("Loaded auto_y: %s", (char*)event.data.scalar.value);
-                    } else if (strcmp(current_key, "menu_bg_color") == 0) {
-                        config.menu_bg_color = parse_color((char*)event.data.scalar.value);
-                    } else if (strcmp(current_key, "menu_text_color") == 0) {
-                        config.menu_text_color = parse_color((char*)event.data.scalar.value);
-                    } else if (strcmp(current_key, "menu_highlight_color") == 0) {
-                        config.menu_highlight_color = parse_color((char*)event.data.scalar.value);
-                    } else if (strcmp(current_key, "menu_font_size") == 0) {
-                        config.menu_font_size = atof((char*)event.data.scalar.value);
-                        LOG_DEBUG("Loaded menu font_size: %.2f", config.menu_font_size);
-                    } else if (strcmp(current_key, "menu_font_name") == 0) {
-                        strncpy(config.menu_font_name, (char*)event.data.scalar.value, sizeof(config.menu_font_name) - 1);
-                        config.menu_font_name[sizeof(config.menu_font_name) - 1] = '\0';
-                        LOG_DEBUG("Loaded menu font_name: %s", config.menu_font_name);
-                    } else {
+                    const char *value = (char*)event.data.scalar.value;
+                    const ConfigKey *key = config_find_key(current_key);
+                    if (!key) {
                         LOG_WARNING("Unknown configuration key: %s", current_key);
+                    } else if (!config_set_value(target, key, value, error, sizeof(error))) {
+                        LOG_WARNING("Ignoring %s: '%s' %s", key->name, value, error);
+                    } else {
+                        LOG_DEBUG("Loaded %s: %s", key->name, value);
                     }
                     current_key[0] = '\0';
                 }
@@ -182,26 +373,8 @@ int load_config(const char* filename) {
     yaml_event_delete(&event);
     yaml_parser_delete(&parser);
     fclose(file);
+    startup_phase("parse config", start);
 
     LOG_INFO("Configuration loaded successfully from %s", config_path);
     return 1;
 }
-
-int string_to_font_weight(const char *weight_str) {
-    if (strcasecmp(weight_str, "Bold") == 0) {
-        return XFT_WEIGHT_BOLD;
-    } else if (strcasecmp(weight_str, "Black") == 0) {
-        return XFT_WEIGHT_BLACK;
-    } else if (strcasecmp(weight_str, "Heavy") == 0) {
-        return FC_WEIGHT_HEAVY;
-    } else if (strcasecmp(weight_str, "Medium") == 0) {
-        return XFT_WEIGHT_MEDIUM;
-    } else if (strcasecmp(weight_str, "Light") == 0) {
-        return XFT_WEIGHT_LIGHT;
-    } else if (strcasecmp(weight_str, "Thin") == 0) {
-        return FC_WEIGHT_THIN;
-    } else {
-        LOG_WARNING("Unknown font weight '%s', using Normal", weight_str);
-        return FC_WEIGHT_NORMAL;
-    }
-}
@@ -1,26 +1,297 @@
 #include "error_report.h"
+#include "log_format.h"
+#include "thread.h"
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <time.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
-static FILE* log_file = NULL;
-static const char* level_strings[] = {
-    "DEBUG", "INFO", "WARNING", "ERROR", "FATAL"
-};
+#define LOG_RING_SIZE 512
+#define LOG_WRITE_BATCH 65536
+
+typedef struct {
+    atomic_size_t sequence;
+    LogRecord record;
+} LogSlot;
+
+static int log_fd = -1;
+static LogOutput log_output = LOG_OUTPUT_TEXT;
 LogLevel current_log_level = LOG_ERROR;
 
-void initialize_logging(const char* log_filename) {
-    log_file = fopen(log_filename, "a");
-    if (log_file == NULL) {
+static LogSlot ring[LOG_RING_SIZE];
+static atomic_size_t enqueue_pos;
+static size_t dequeue_pos;
+static atomic_ulong written_records;
+static atomic_ulong dropped_records;
+static unsigned long reported_drops;
+
+static pthread_t writer_thread;
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_wakeup = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t sync_lock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_int writer_running;
+static atomic_int writer_sleeping;
+static int stop_requested;
+
+static char text_batch[LOG_WRITE_BATCH];
+static size_t text_len;
+static uint8_t binary_batch[LOG_WRITE_BATCH];
+static size_t binary_len;
+static uint32_t next_site_id;
+static time_t last_binary_timestamp;
+
+static LogSite drop_site = { LOG_WARNING, __LINE__, __FILE__, 0 };
+
+static void write_all(int fd, const void *buffer, size_t len) {
+    const char *data = buffer;
+
+    while (len > 0) {
+        ssize_t written = write(fd, data, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += written;
+        len -= written;
+    }
+}
+
+static void fill_record(LogRecord *record, LogSite *site, const char *format, va_list args) {
+    record->site = site;
+    record->timestamp = time(NULL);
+    log_capture(record, format, args);
+}
+
+static int enqueue_record(LogSite *site, const char *format, va_list args) {
+    size_t pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+    LogSlot *slot;
+
+    for (;;) {
+        slot = &ring[pos & (LOG_RING_SIZE - 1)];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return 0;
+        } else {
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    fill_record(&slot->record, site, format, args);
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&writer_sleeping, memory_order_relaxed)) {
+        pthread_mutex_lock(&writer_lock);
+        pthread_cond_signal(&writer_wakeup);
+        pthread_mutex_unlock(&writer_lock);
+    }
+    return 1;
+}
+
+static LogRecord *peek_record(void) {
+    LogSlot *slot = &ring[dequeue_pos & (LOG_RING_SIZE - 1)];
+    size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    return sequence == dequeue_pos + 1 ? &slot->record : NULL;
+}
+
+static void release_record(void) {
+    LogSlot *slot = &ring[dequeue_pos & (LOG_RING_SIZE - 1)];
+    atomic_store_explicit(&slot->sequence, dequeue_pos + LOG_RING_SIZE, memory_order_release);
+    dequeue_pos++;
+}
+
+static void flush_batches(void) {
+    if (binary_len > 0) {
+        if (log_fd != -1) {
+            write_all(log_fd, binary_batch, binary_len);
+        }
+        binary_len = 0;
+    }
+    if (text_len > 0) {
+        if (log_output == LOG_OUTPUT_TEXT && log_fd != -1) {
+            write_all(log_fd, text_batch, text_len);
+        }
+        write_all(STDERR_FILENO, text_batch, text_len);
+        text_len = 0;
+    }
+}
+
+static void emit_record(const LogRecord *record) {
+    if (log_output == LOG_OUTPUT_BINARY) {
+        LogSite *site = record->site;
+        if (binary_len + 2 * LOG_BINARY_ENTRY_MAX > sizeof(binary_batch)) {
+            flush_batches();
+        }
+        if (site->id == 0) {
+            site->id = ++next_site_id;
+            binary_len += log_encode_site(binary_batch + binary_len, site, record->format);
+        }
+        binary_len += log_encode_event(binary_batch + binary_len, record, &last_binary_timestamp);
+        if (site->level < LOG_WARNING) {
+            return;
+        }
+    }
+
+    if (text_len + LOG_LINE_MAX > sizeof(text_batch)) {
+        flush_batches();
+    }
+    text_len += log_format_line(record, text_batch + text_len, LOG_LINE_MAX);
+}
+
+static void emit_internal(LogSite *site, const char *format, ...) {
+    LogRecord record;
+    va_list args;
+
+    va_start(args, format);
+    fill_record(&record, site, format, args);
+    va_end(args);
+    emit_record(&record);
+}
+
+static void report_drops(void) {
+    unsigned long dropped = atomic_load_explicit(&dropped_records, memory_order_relaxed);
+    if (dropped == reported_drops) {
+        return;
+    }
+
+    emit_internal(&drop_site, "Log buffer full, dropped %lu messages", dropped - reported_drops);
+    reported_drops = dropped;
+}
+
+static void drain_ring(void) {
+    LogRecord *record;
+    unsigned long written = 0;
+
+    while ((record = peek_record())) {
+        emit_record(record);
+        release_record();
+        written++;
+    }
+    atomic_fetch_add_explicit(&written_records, written, memory_order_relaxed);
+    report_drops();
+    flush_batches();
+}
+
+static void *log_writer(void *arg) {
+    (void)arg;
+    int stopping = 0;
+
+    while (!stopping) {
+        drain_ring();
+
+        pthread_mutex_lock(&writer_lock);
+        atomic_store(&writer_sleeping, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (!stop_requested && !peek_record()) {
+            pthread_cond_wait(&writer_wakeup, &writer_lock);
+        }
+        atomic_store(&writer_sleeping, 0);
+        stopping = stop_requested;
+        pthread_mutex_unlock(&writer_lock);
+    }
+
+    drain_ring();
+    return NULL;
+}
+
+static void stop_writer(void) {
+    if (!atomic_exchange(&writer_running, 0)) {
+        return;
+    }
+
+    pthread_mutex_lock(&writer_lock);
+    stop_requested = 1;
+    pthread_cond_signal(&writer_wakeup);
+    pthread_mutex_unlock(&writer_lock);
+    pthread_join(writer_thread, NULL);
+
+    drain_ring();
+}
+
+static void write_record_now(LogSite *site, const char *format, va_list args) {
+    LogRecord record;
+
+    fill_record(&record, site, format, args);
+    pthread_mutex_lock(&sync_lock);
+    emit_record(&record);
+    flush_batches();
+    pthread_mutex_unlock(&sync_lock);
+    atomic_fetch_add_explicit(&written_records, 1, memory_order_relaxed);
+}
+
+static int start_binary_log(const char *log_filename) {
+    struct stat st;
+    char magic[LOG_BINARY_MAGIC_LEN];
+    uint8_t session[LOG_BINARY_ENTRY_MAX];
+
+    if (fstat(log_fd, &st) == -1) {
+        return 0;
+    }
+    if (st.st_size == 0) {
+        write_all(log_fd, LOG_BINARY_MAGIC, LOG_BINARY_MAGIC_LEN);
+    } else if (pread(log_fd, magic, sizeof(magic), 0) != sizeof(magic) ||
+               memcmp(magic, LOG_BINARY_MAGIC, LOG_BINARY_MAGIC_LEN) != 0) {
+        fprintf(stderr, "Log file %s exists and is not a binary log\n", log_filename);
+        return 0;
+    }
+
+    last_binary_timestamp = time(NULL);
+    write_all(log_fd, session, log_encode_session(session, last_binary_timestamp, getpid()));
+    return 1;
+}
+
+void initialize_logging(const char* log_filename, LogOutput output) {
+    static int cleanup_registered = 0;
+
+    log_output = output;
+    log_fd = open(log_filename, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (log_fd == -1) {
         fprintf(stderr, "Failed to open log file: %s\n", log_filename);
         exit(EXIT_FAILURE);
     }
+    if (output == LOG_OUTPUT_BINARY && !start_binary_log(log_filename)) {
+        exit(EXIT_FAILURE);
+    }
+
+    if (!cleanup_registered) {
+        atexit(cleanup_logging);
+        cleanup_registered = 1;
+    }
+
+    for (size_t i = 0; i < LOG_RING_SIZE; i++) {
+        atomic_init(&ring[i].sequence, i);
+    }
+    atomic_store(&enqueue_pos, 0);
+    dequeue_pos = 0;
+    stop_requested = 0;
+
+    int error = start_worker_thread(&writer_thread, log_writer, NULL);
+
+    if (error != 0) {
+        fprintf(stderr, "Failed to start log writer thread, logging synchronously: %s\n", strerror(error));
+        return;
+    }
+    atomic_store(&writer_running, 1);
 }
 
 void cleanup_logging(void) {
-    if (log_file != NULL) {
-        fclose(log_file);
-        log_file = NULL;
+    stop_writer();
+    if (log_fd != -1) {
+        close(log_fd);
+        log_fd = -1;
     }
 }
 
@@ -28,35 +299,36 @@ void set_log_level(LogLevel level) {
     current_log_level = level;
 }
 
-void log_message(LogLevel level, const char* file, int line, const char* format, ...) {
+void get_log_stats(LogStats *stats) {
+    stats->written = atomic_load_explicit(&written_records, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&dropped_records, memory_order_relaxed);
+}
+
+void log_message(LogSite *site, const char* format, ...) {
+    LogLevel level = site->level;
     if (level < current_log_level) {
         return;
     }
 
     va_list args;
-    char buffer[1024];
-    time_t now;
-    char time_buffer[26];
-    struct tm* tm_info;
-
     va_start(args, format);
-    vsnprintf(buffer, sizeof(buffer), format, args);
-    va_end(args);
-
-    now = time(NULL);
-    tm_info = localtime(&now);
-    strftime(time_buffer, 26, "%Y-%m-%d %H:%M:%S", tm_info);
 
-    if (log_file != NULL) {
-        fprintf(log_file, "[%s] %s %s:%d: %s\n", time_buffer, level_strings[level], file, line, buffer);
-        fflush(log_file);
+    if (level != LOG_FATAL && atomic_load_explicit(&writer_running, memory_order_acquire)) {
+        if (!enqueue_record(site, format, args)) {
+            atomic_fetch_add_explicit(&dropped_records, 1, memory_order_relaxed);
+        }
+        va_end(args);
+        return;
     }
 
-    if (level >= current_log_level) {
-        fprintf(stderr, "[%s] %s %s:%d: %s\n", time_buffer, level_strings[level], file, line, buffer);
+    if (level == LOG_FATAL) {
+        stop_writer();
     }
+    write_record_now(site, format, args);
+    va_end(args);
 
     if (level == LOG_FATAL) {
+        cleanup_logging();
         exit(EXIT_FAILURE);
     }
 }
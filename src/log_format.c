@@ -0,0 +1,569 @@
+#include "log_format.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+
+typedef enum {
+    LENGTH_NONE,
+    LENGTH_HH,
+    LENGTH_H,
+    LENGTH_L,
+    LENGTH_LL,
+    LENGTH_Z,
+    LENGTH_J,
+    LENGTH_T,
+    LENGTH_LONG_DOUBLE
+} LengthModifier;
+
+typedef struct {
+    const char *start;
+    const char *modifier;
+    int width_star;
+    int precision_star;
+    int precision;
+    LengthModifier length;
+    char conversion;
+    int type;
+} ConversionSpec;
+
+#define CONVERSION_PERCENT -1
+
+static const char *level_names[] = {
+    "DEBUG", "INFO", "WARNING", "ERROR", "FATAL"
+};
+
+const char *log_level_name(int level) {
+    if (level < 0 || level >= (int)(sizeof(level_names) / sizeof(level_names[0]))) {
+        return "UNKNOWN";
+    }
+    return level_names[level];
+}
+
+static const char *parse_conversion(const char *p, ConversionSpec *spec) {
+    spec->start = p++;
+    spec->width_star = 0;
+    spec->precision_star = 0;
+    spec->precision = -1;
+
+    while (*p && strchr("-+ #0'", *p)) {
+        p++;
+    }
+    if (*p == '*') {
+        spec->width_star = 1;
+        p++;
+    } else {
+        while (isdigit((unsigned char)*p)) {
+            p++;
+        }
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->precision_star = 1;
+            p++;
+        } else {
+            spec->precision = 0;
+            while (isdigit((unsigned char)*p)) {
+                spec->precision = spec->precision * 10 + (*p - '0');
+                p++;
+            }
+        }
+    }
+
+    spec->modifier = p;
+    spec->length = LENGTH_NONE;
+    switch (*p) {
+        case 'h':
+            spec->length = p[1] == 'h' ? LENGTH_HH : LENGTH_H;
+            p += p[1] == 'h' ? 2 : 1;
+            break;
+        case 'l':
+            spec->length = p[1] == 'l' ? LENGTH_LL : LENGTH_L;
+            p += p[1] == 'l' ? 2 : 1;
+            break;
+        case 'z': spec->length = LENGTH_Z; p++; break;
+        case 'j': spec->length = LENGTH_J; p++; break;
+        case 't': spec->length = LENGTH_T; p++; break;
+        case 'L': spec->length = LENGTH_LONG_DOUBLE; p++; break;
+    }
+
+    spec->conversion = *p;
+    switch (*p) {
+        case 'd': case 'i': case 'c':
+            spec->type = LOG_ARG_INT;
+            break;
+        case 'u': case 'o': case 'x': case 'X':
+            spec->type = LOG_ARG_UINT;
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            spec->type = LOG_ARG_DOUBLE;
+            break;
+        case 's':
+            spec->type = LOG_ARG_STRING;
+            break;
+        case 'p':
+            spec->type = LOG_ARG_POINTER;
+            break;
+        case '%':
+            spec->type = CONVERSION_PERCENT;
+            break;
+        default:
+            return NULL;
+    }
+    return p + 1;
+}
+
+static long long read_signed(va_list *args, LengthModifier length) {
+    switch (length) {
+        case LENGTH_HH: return (signed char)va_arg(*args, int);
+        case LENGTH_H: return (short)va_arg(*args, int);
+        case LENGTH_L: return va_arg(*args, long);
+        case LENGTH_LL: return va_arg(*args, long long);
+        case LENGTH_Z: return va_arg(*args, ssize_t);
+        case LENGTH_J: return va_arg(*args, intmax_t);
+        case LENGTH_T: return va_arg(*args, ptrdiff_t);
+        default: return va_arg(*args, int);
+    }
+}
+
+static unsigned long long read_unsigned(va_list *args, LengthModifier length) {
+    switch (length) {
+        case LENGTH_HH: return (unsigned char)va_arg(*args, unsigned int);
+        case LENGTH_H: return (unsigned short)va_arg(*args, unsigned int);
+        case LENGTH_L: return va_arg(*args, unsigned long);
+        case LENGTH_LL: return va_arg(*args, unsigned long long);
+        case LENGTH_Z: return va_arg(*args, size_t);
+        case LENGTH_J: return va_arg(*args, uintmax_t);
+        case LENGTH_T: return (unsigned long long)va_arg(*args, ptrdiff_t);
+        default: return va_arg(*args, unsigned int);
+    }
+}
+
+static LogArg *next_arg(LogRecord *record, LogArgType type) {
+    if (record->arg_count >= LOG_MAX_ARGS) {
+        return NULL;
+    }
+    LogArg *arg = &record->args[record->arg_count++];
+    arg->type = type;
+    return arg;
+}
+
+static void capture_string(LogRecord *record, LogArg *arg, const char *string, int precision) {
+    size_t space = LOG_STRING_SPACE - record->string_len - 1;
+    if (precision >= 0 && (size_t)precision < space) {
+        space = precision;
+    }
+    if (!string) {
+        string = "(null)";
+    }
+
+    size_t length = strnlen(string, space);
+    arg->value.offset = record->string_len;
+    memcpy(record->strings + record->string_len, string, length);
+    record->strings[record->string_len + length] = '\0';
+    record->string_len += length + 1;
+}
+
+void log_capture(LogRecord *record, const char *format, va_list args) {
+    va_list ap;
+    const char *p = format;
+
+    record->format = format;
+    record->arg_count = 0;
+    record->string_len = 0;
+
+    va_copy(ap, args);
+    while ((p = strchr(p, '%'))) {
+        ConversionSpec spec;
+        const char *next = parse_conversion(p, &spec);
+        if (!next) {
+            break;
+        }
+        p = next;
+        if (spec.type == CONVERSION_PERCENT) {
+            continue;
+        }
+
+        LogArg *arg;
+        int precision = spec.precision;
+        if (spec.width_star) {
+            if (!(arg = next_arg(record, LOG_ARG_INT))) {
+                break;
+            }
+            arg->value.i = va_arg(ap, int);
+        }
+        if (spec.precision_star) {
+            if (!(arg = next_arg(record, LOG_ARG_INT))) {
+                break;
+            }
+            precision = va_arg(ap, int);
+            arg->value.i = precision;
+        }
+        if (!(arg = next_arg(record, spec.type))) {
+            break;
+        }
+
+        switch (spec.type) {
+            case LOG_ARG_INT:
+                arg->value.i = read_signed(&ap, spec.length);
+                break;
+            case LOG_ARG_UINT:
+                arg->value.u = read_unsigned(&ap, spec.length);
+                break;
+            case LOG_ARG_DOUBLE:
+                arg->value.d = spec.length == LENGTH_LONG_DOUBLE ? (double)va_arg(ap, long double)
+                                                                 : va_arg(ap, double);
+                break;
+            case LOG_ARG_POINTER:
+                arg->value.p = va_arg(ap, void*);
+                break;
+            case LOG_ARG_STRING:
+                capture_string(record, arg, va_arg(ap, const char*), precision);
+                break;
+        }
+    }
+    va_end(ap);
+}
+
+static size_t append_text(char *out, size_t size, size_t pos, const char *text, size_t length) {
+    if (pos + length >= size) {
+        length = size - pos - 1;
+    }
+    memcpy(out + pos, text, length);
+    out[pos + length] = '\0';
+    return pos + length;
+}
+
+static int build_conversion(const LogRecord *record, const ConversionSpec *spec, int *index,
+                            char *conversion, size_t size) {
+    size_t len = 0;
+    int matches = 1;
+
+    for (const char *p = spec->start; p < spec->modifier; p++) {
+        if (*p == '*') {
+            if (*index >= record->arg_count) {
+                return 0;
+            }
+            const LogArg *arg = &record->args[(*index)++];
+            if (arg->type != LOG_ARG_INT) {
+                matches = 0;
+                continue;
+            }
+            len += snprintf(conversion + len, size - len, "%lld", arg->value.i);
+        } else {
+            conversion[len++] = *p;
+        }
+        if (len + 4 >= size) {
+            return 0;
+        }
+    }
+
+    if ((spec->type == LOG_ARG_INT || spec->type == LOG_ARG_UINT) && spec->conversion != 'c') {
+        conversion[len++] = 'l';
+        conversion[len++] = 'l';
+    }
+    conversion[len++] = spec->conversion;
+    conversion[len] = '\0';
+    if (*index >= record->arg_count) {
+        return 0;
+    }
+    return matches && record->args[*index].type == spec->type ? 1 : -1;
+}
+
+size_t log_format_message(const LogRecord *record, char *out, size_t size) {
+    const char *p = record->format;
+    size_t pos = 0;
+    int index = 0;
+
+    if (size == 0) {
+        return 0;
+    }
+    out[0] = '\0';
+
+    while (*p && pos + 1 < size) {
+        const char *percent = strchr(p, '%');
+        if (!percent) {
+            pos = append_text(out, size, pos, p, strlen(p));
+            break;
+        }
+        pos = append_text(out, size, pos, p, percent - p);
+
+        ConversionSpec spec;
+        char conversion[64];
+        const char *next = parse_conversion(percent, &spec);
+        if (next && spec.type == CONVERSION_PERCENT) {
+            pos = append_text(out, size, pos, "%", 1);
+            p = next;
+            continue;
+        }
+        int built = next ? build_conversion(record, &spec, &index, conversion, sizeof(conversion)) : 0;
+        if (built == 0) {
+            pos = append_text(out, size, pos, percent, strlen(percent));
+            break;
+        }
+        p = next;
+        if (built < 0) {
+            pos = append_text(out, size, pos, "<bad arg>", 9);
+            index++;
+            continue;
+        }
+
+        const LogArg *arg = &record->args[index++];
+        char *dst = out + pos;
+        size_t available = size - pos;
+        int written = 0;
+        switch (arg->type) {
+            case LOG_ARG_INT:
+                written = spec.conversion == 'c' ? snprintf(dst, available, conversion, (int)arg->value.i)
+                                                 : snprintf(dst, available, conversion, arg->value.i);
+                break;
+            case LOG_ARG_UINT:
+                written = snprintf(dst, available, conversion, arg->value.u);
+                break;
+            case LOG_ARG_DOUBLE:
+                written = snprintf(dst, available, conversion, arg->value.d);
+                break;
+            case LOG_ARG_POINTER:
+                written = snprintf(dst, available, conversion, arg->value.p);
+                break;
+            case LOG_ARG_STRING:
+                written = snprintf(dst, available, conversion, record->strings + arg->value.offset);
+                break;
+        }
+        if (written > 0) {
+            pos += (size_t)written < available ? (size_t)written : available - 1;
+        }
+    }
+    return pos;
+}
+
+static const char *format_timestamp(time_t timestamp) {
+    static time_t cached_second = -1;
+    static char cached[26];
+
+    if (timestamp != cached_second) {
+        struct tm tm_info;
+        localtime_r(&timestamp, &tm_info);
+        strftime(cached, sizeof(cached), "%Y-%m-%d %H:%M:%S", &tm_info);
+        cached_second = timestamp;
+    }
+    return cached;
+}
+
+size_t log_format_line(const LogRecord *record, char *out, size_t size) {
+    int header = snprintf(out, size, "[%s] %s %s:%d: ", format_timestamp(record->timestamp),
+                          log_level_name(record->site->level), record->site->file, record->site->line);
+    size_t len = (size_t)header < size ? (size_t)header : size - 1;
+
+    len += log_format_message(record, out + len, size - len - 1);
+    out[len++] = '\n';
+    return len;
+}
+
+static size_t put_varint(uint8_t *out, uint64_t value) {
+    size_t len = 0;
+    while (value >= 0x80) {
+        out[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[len++] = (uint8_t)value;
+    return len;
+}
+
+static size_t put_bytes(uint8_t *out, const char *data, size_t length) {
+    size_t len = put_varint(out, length);
+    memcpy(out + len, data, length);
+    return len + length;
+}
+
+static uint64_t zigzag_encode(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t zigzag_decode(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static int get_varint(const uint8_t *data, size_t len, size_t *pos, uint64_t *value) {
+    uint64_t result = 0;
+
+    for (int shift = 0; shift < 64 && *pos < len; shift += 7) {
+        uint8_t byte = data[(*pos)++];
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int get_bytes(const uint8_t *data, size_t len, size_t *pos, const char **bytes, size_t *length) {
+    uint64_t value;
+    if (!get_varint(data, len, pos, &value) || value > len - *pos) {
+        return 0;
+    }
+    *bytes = (const char*)data + *pos;
+    *length = value;
+    *pos += value;
+    return 1;
+}
+
+size_t log_encode_session(uint8_t *out, time_t timestamp, uint32_t pid) {
+    size_t len = 0;
+    out[len++] = LOG_BINARY_SESSION;
+    len += put_varint(out + len, zigzag_encode(timestamp));
+    len += put_varint(out + len, pid);
+    return len;
+}
+
+size_t log_encode_site(uint8_t *out, const LogSite *site, const char *format) {
+    size_t len = 0;
+    out[len++] = LOG_BINARY_SITE;
+    len += put_varint(out + len, site->id);
+    len += put_varint(out + len, site->level);
+    len += put_varint(out + len, site->line);
+    len += put_bytes(out + len, site->file, strnlen(site->file, LOG_MESSAGE_MAX));
+    len += put_bytes(out + len, format, strnlen(format, LOG_MESSAGE_MAX));
+    return len;
+}
+
+size_t log_encode_event(uint8_t *out, const LogRecord *record, time_t *last_timestamp) {
+    size_t len = 0;
+    out[len++] = LOG_BINARY_EVENT;
+    len += put_varint(out + len, record->site->id);
+    len += put_varint(out + len, zigzag_encode(record->timestamp - *last_timestamp));
+    len += put_varint(out + len, record->arg_count);
+    *last_timestamp = record->timestamp;
+
+    for (int i = 0; i < record->arg_count; i++) {
+        const LogArg *arg = &record->args[i];
+        out[len++] = arg->type;
+        switch (arg->type) {
+            case LOG_ARG_INT:
+                len += put_varint(out + len, zigzag_encode(arg->value.i));
+                break;
+            case LOG_ARG_UINT:
+                len += put_varint(out + len, arg->value.u);
+                break;
+            case LOG_ARG_DOUBLE:
+                memcpy(out + len, &arg->value.d, sizeof(double));
+                len += sizeof(double);
+                break;
+            case LOG_ARG_POINTER:
+                len += put_varint(out + len, (uintptr_t)arg->value.p);
+                break;
+            case LOG_ARG_STRING: {
+                const char *string = record->strings + arg->value.offset;
+                len += put_bytes(out + len, string, strlen(string));
+                break;
+            }
+        }
+    }
+    return len;
+}
+
+static int decode_event_args(const uint8_t *data, size_t len, size_t *pos, LogRecord *record) {
+    uint64_t value;
+    const char *bytes;
+    size_t length;
+
+    if (!get_varint(data, len, pos, &value) || value > LOG_MAX_ARGS) {
+        return 0;
+    }
+    record->arg_count = value;
+    record->string_len = 0;
+
+    for (int i = 0; i < record->arg_count; i++) {
+        LogArg *arg = &record->args[i];
+        if (*pos >= len) {
+            return 0;
+        }
+        arg->type = data[(*pos)++];
+        switch (arg->type) {
+            case LOG_ARG_INT:
+                if (!get_varint(data, len, pos, &value)) {
+                    return 0;
+                }
+                arg->value.i = zigzag_decode(value);
+                break;
+            case LOG_ARG_UINT:
+                if (!get_varint(data, len, pos, &value)) {
+                    return 0;
+                }
+                arg->value.u = value;
+                break;
+            case LOG_ARG_DOUBLE:
+                if (len - *pos < sizeof(double)) {
+                    return 0;
+                }
+                memcpy(&arg->value.d, data + *pos, sizeof(double));
+                *pos += sizeof(double);
+                break;
+            case LOG_ARG_POINTER:
+                if (!get_varint(data, len, pos, &value)) {
+                    return 0;
+                }
+                arg->value.p = (const void*)(uintptr_t)value;
+                break;
+            case LOG_ARG_STRING:
+                if (!get_bytes(data, len, pos, &bytes, &length) ||
+                    length >= (size_t)(LOG_STRING_SPACE - record->string_len)) {
+                    return 0;
+                }
+                arg->value.offset = record->string_len;
+                memcpy(record->strings + record->string_len, bytes, length);
+                record->strings[record->string_len + length] = '\0';
+                record->string_len += length + 1;
+                break;
+            default:
+                return 0;
+        }
+    }
+    return 1;
+}
+
+size_t log_decode_entry(const uint8_t *data, size_t len, time_t *last_timestamp, LogBinaryEntry *entry) {
+    size_t pos = 0;
+    uint64_t id, level, line, timestamp, pid;
+
+    if (len == 0) {
+        return 0;
+    }
+
+    entry->type = data[pos++];
+    switch (entry->type) {
+        case LOG_BINARY_SESSION:
+            if (!get_varint(data, len, &pos, &timestamp) || !get_varint(data, len, &pos, &pid)) {
+                return 0;
+            }
+            entry->timestamp = zigzag_decode(timestamp);
+            entry->pid = pid;
+            *last_timestamp = entry->timestamp;
+            break;
+        case LOG_BINARY_SITE:
+            if (!get_varint(data, len, &pos, &id) || !get_varint(data, len, &pos, &level) ||
+                !get_varint(data, len, &pos, &line) ||
+                !get_bytes(data, len, &pos, &entry->file, &entry->file_len) ||
+                !get_bytes(data, len, &pos, &entry->format, &entry->format_len)) {
+                return 0;
+            }
+            entry->site_id = id;
+            entry->level = level;
+            entry->line = line;
+            break;
+        case LOG_BINARY_EVENT:
+            if (!get_varint(data, len, &pos, &id) || !get_varint(data, len, &pos, &timestamp) ||
+                !decode_event_args(data, len, &pos, &entry->record)) {
+                return 0;
+            }
+            entry->site_id = id;
+            entry->record.timestamp = *last_timestamp + zigzag_decode(timestamp);
+            *last_timestamp = entry->record.timestamp;
+            break;
+        default:
+            return 0;
+    }
+    return pos;
+}
@@ -3,9 +3,22 @@
 #include "chronotask.h"
 #include "error_report.h"
 #include "routine_selector.h"
+#include "window.h"
+#include "startup.h"
+#include "audio.h"
+#include "overlay.h"
 #include <string.h>
 #include <stdio.h>
 
+void print_config(void) {
+    char value[512];
+
+    for (int i = 0; i < config_key_count; i++) {
+        config_format_value(&config, &config_keys[i], value, sizeof(value));
+        printf("%s: %s\n", config_keys[i].name, value);
+    }
+}
+
 LogLevel parse_log_level(const char* level_str) {
     if (level_str == NULL || strcmp(level_str, "info") == 0) {
         return LOG_INFO;
@@ -25,6 +38,10 @@ int main(int argc, char *argv[]) {
     const char* config_file = "config.yaml";
     const char* routine_name = NULL;
     LogLevel log_level = LOG_ERROR;
+    LogOutput log_output = LOG_OUTPUT_TEXT;
+    int dump_config = 0;
+
+    startup_begin();
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--verbose") == 0) {
@@ -35,53 +52,83 @@ int main(int argc, char *argv[]) {
             }
         } else if (strncmp(argv[i], "--verbose=", 10) == 0) {
             log_level = parse_log_level(argv[i] + 10);
+        } else if (strcmp(argv[i], "--binary-log") == 0) {
+            log_output = LOG_OUTPUT_BINARY;
+        } else if (strncmp(argv[i], "--trace-startup=", 16) == 0) {
+            startup_set_trace_file(argv[i] + 16);
+        } else if (strcmp(argv[i], "--dump-config") == 0) {
+            dump_config = 1;
         } else if (routine_name == NULL) {
             routine_name = argv[i];
         }
     }
 
-    initialize_logging("chronoTask.log");
+    if (log_output == LOG_OUTPUT_BINARY) {
+        initialize_logging("chronoTask.binlog", log_output);
+    } else {
+        initialize_logging("chronoTask.log", log_output);
+    }
     set_log_level(log_level);
 
     LOG_INFO("ChronoTask starting up");
+    startup_stage("logging");
 
     if (!load_config(config_file)) {
         LOG_FATAL("Failed to load configuration from %s", config_file);
     }
+    startup_stage("config");
 
-    char routines_file[512];
-    snprintf(routines_file, sizeof(routines_file), "%s.yaml", config.routines);
+    if (dump_config) {
+        print_config();
+        cleanup_logging();
+        return 0;
+    }
 
-    if (!load_routines(routines_file)) {
-        LOG_FATAL("Failed to load routines from file: %s", routines_file);
+    if (!load_routines(config.routines)) {
+        LOG_FATAL("Failed to load routines: %s", config.routines);
     }
+    startup_stage("routines");
+
+    if (routine_name != NULL && !select_routine(routine_name)) {
+        LOG_ERROR("Routine '%s' not found", routine_name);
+        list_routines();
+        cleanup_routines();
+        cleanup_logging();
+        return 1;
+    }
+
+    start_audio();
+    overlay_preload_fonts();
+
+    if (!initialize_display()) {
+        LOG_FATAL("Failed to initialize display");
+    }
+    startup_stage("display");
 
     if (routine_name == NULL) {
-        int selected = select_routine_gui(&routine_list);
-        if (selected >= 0) {
-            current_routine = selected;
-        } else {
+        int selected = select_routine_gui(get_display(), &routine_list);
+        if (selected < 0) {
             LOG_INFO("User cancelled routine selection");
+            cleanup_display();
+            cleanup_audio();
+            cleanup_routines();
             cleanup_logging();
             return 1;
         }
-    } else {
-        if (!select_routine(routine_name)) {
-            LOG_ERROR("Routine '%s' not found", routine_name);
-            list_routines();
-            cleanup_logging();
-            return 1;
-        }
+        current_routine = selected;
+        startup_wait("routine selection");
     }
 
     if (!initialize_tasks()) {
         LOG_FATAL("Failed to initialize tasks");
     }
+    startup_stage("tasks");
 
     LOG_INFO("Starting ChronoTask with routine: %s", routine_list.routines[current_routine].name);
     int result = run_chronotask(config_file);
     LOG_INFO("ChronoTask exited with result: %d", result);
 
+    cleanup_routines();
     cleanup_logging();
     return result;
 }
@@ -0,0 +1,199 @@
+#include "metrics.h"
+#include "config.h"
+#include "task.h"
+#include "stats.h"
+#include "socket.h"
+#include "timekeeper.h"
+#include "error_report.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+
+#define FIRST_EXPORTED_BUCKET 10
+#define LAST_EXPORTED_BUCKET 30
+
+static unsigned long tasks_completed = 0;
+static unsigned long pauses = 0;
+static unsigned long extends = 0;
+static long extended_seconds = 0;
+static int64_t focus_ns = 0;
+static int64_t last_sample = 0;
+static int last_paused = 1;
+
+static Buffer contents = {0};
+static Buffer written = {0};
+static char written_path[PATH_MAX] = "";
+
+void metrics_task_completed(void) {
+    tasks_completed++;
+}
+
+void metrics_task_paused(void) {
+    pauses++;
+}
+
+void metrics_task_extended(int seconds) {
+    extends++;
+    extended_seconds += seconds;
+}
+
+static void sample_focus_time(void) {
+    int64_t now = now_ns();
+    if (last_sample != 0 && !last_paused) {
+        focus_ns += now - last_sample;
+    }
+    last_sample = now;
+    last_paused = is_task_paused();
+}
+
+static void append_label_value(Buffer *out, const char *value) {
+    for (; *value; value++) {
+        if (*value == '\\' || *value == '"') {
+            buffer_printf(out, "\\%c", *value);
+        } else if (*value == '\n') {
+            buffer_printf(out, "\\n");
+        } else {
+            buffer_append(out, value, 1);
+        }
+    }
+}
+
+static void append_metric(Buffer *out, const char *name, const char *type, const char *help) {
+    buffer_printf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void append_histogram(Buffer *out, const char *name, const char *labels, const Histogram *histogram) {
+    const char *separator = labels[0] != '\0' ? "," : "";
+    const char *open = labels[0] != '\0' ? "{" : "";
+    const char *close = labels[0] != '\0' ? "}" : "";
+    unsigned long cumulative = 0;
+
+    for (int i = 0; i <= LAST_EXPORTED_BUCKET; i++) {
+        cumulative += histogram->buckets[i];
+        if (i < FIRST_EXPORTED_BUCKET) {
+            continue;
+        }
+        buffer_printf(out, "%s_bucket{%s%sle=\"%.10g\"} %lu\n", name, labels, separator,
+                      (double)((int64_t)1 << i) / NSEC_PER_SEC, cumulative);
+    }
+    buffer_printf(out, "%s_bucket{%s%sle=\"+Inf\"} %lu\n", name, labels, separator, histogram->count);
+    buffer_printf(out, "%s_sum%s%s%s %.9f\n", name, open, labels, close,
+                  (double)histogram->total_ns / NSEC_PER_SEC);
+    buffer_printf(out, "%s_count%s%s%s %lu\n", name, open, labels, close, histogram->count);
+}
+
+static void format_metrics(Buffer *out) {
+    Routine *routine = &routine_list.routines[current_routine];
+
+    append_metric(out, "chronotask_task_info", "gauge", "Current routine and task.");
+    buffer_printf(out, "chronotask_task_info{routine=\"");
+    append_label_value(out, routine->name);
+    buffer_printf(out, "\",task=\"");
+    append_label_value(out, get_current_task_name());
+    buffer_printf(out, "\"} 1\n");
+
+    int64_t remaining = get_task_remaining_ns();
+    append_metric(out, "chronotask_task_seconds_remaining", "gauge", "Seconds left in the current task at the last state change.");
+    buffer_printf(out, "chronotask_task_seconds_remaining %d\n", ns_to_display_seconds(remaining));
+    append_metric(out, "chronotask_paused", "gauge", "Whether the current task is paused.");
+    buffer_printf(out, "chronotask_paused %d\n", is_task_paused());
+    if (!is_task_paused()) {
+        struct timespec wall;
+        clock_gettime(CLOCK_REALTIME, &wall);
+        int64_t deadline = (int64_t)wall.tv_sec * NSEC_PER_SEC + wall.tv_nsec + remaining;
+        append_metric(out, "chronotask_task_deadline_timestamp_seconds", "gauge", "Unix time at which the running task ends.");
+        buffer_printf(out, "chronotask_task_deadline_timestamp_seconds %lld\n",
+                      (long long)((deadline + NSEC_PER_SEC / 2) / NSEC_PER_SEC));
+    }
+
+    append_metric(out, "chronotask_tasks_completed_total", "counter", "Tasks that ran to the end of their time.");
+    buffer_printf(out, "chronotask_tasks_completed_total %lu\n", tasks_completed);
+    append_metric(out, "chronotask_focus_seconds_total", "counter", "Time spent with a task running.");
+    buffer_printf(out, "chronotask_focus_seconds_total %lld\n", (long long)(focus_ns / NSEC_PER_SEC));
+    append_metric(out, "chronotask_pauses_total", "counter", "Times a task was paused.");
+    buffer_printf(out, "chronotask_pauses_total %lu\n", pauses);
+    append_metric(out, "chronotask_extends_total", "counter", "Times a task was extended.");
+    buffer_printf(out, "chronotask_extends_total %lu\n", extends);
+    append_metric(out, "chronotask_extended_seconds_total", "counter", "Time added to tasks by extends.");
+    buffer_printf(out, "chronotask_extended_seconds_total %ld\n", extended_seconds);
+
+    append_metric(out, "chronotask_loop_wakeups_total", "counter", "Main loop wakeups from poll.");
+    buffer_printf(out, "chronotask_loop_wakeups_total %lu\n", runtime_stats.wakeups);
+    append_metric(out, "chronotask_frame_render_seconds", "histogram", "Time to render an overlay frame.");
+    append_histogram(out, "chronotask_frame_render_seconds", "", &runtime_stats.frame_time);
+    append_metric(out, "chronotask_command_duration_seconds", "histogram", "Time to handle a control command.");
+    for (int i = 0; i < COMMAND_TYPE_COUNT; i++) {
+        char labels[64];
+        if (runtime_stats.commands[i].count > 0) {
+            snprintf(labels, sizeof(labels), "command=\"%s\"", stats_command_name(i));
+            append_histogram(out, "chronotask_command_duration_seconds", labels, &runtime_stats.commands[i]);
+        }
+    }
+}
+
+static int write_metrics_file(const char *path, const Buffer *out) {
+    char temp_path[PATH_MAX + 8];
+    size_t done = 0;
+
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        LOG_WARNING("Failed to create metrics file %s: %s", temp_path, strerror(errno));
+        return 0;
+    }
+
+    while (done < out->len) {
+        ssize_t n = write(fd, out->data + done, out->len - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        done += n;
+    }
+
+    if (close(fd) == -1 || done != out->len || rename(temp_path, path) == -1) {
+        LOG_WARNING("Failed to write metrics file %s: %s", path, strerror(errno));
+        unlink(temp_path);
+        return 0;
+    }
+    return 1;
+}
+
+void metrics_update(void) {
+    sample_focus_time();
+
+    if (strcmp(written_path, config.metrics_file) != 0) {
+        if (written_path[0] != '\0') {
+            unlink(written_path);
+        }
+        snprintf(written_path, sizeof(written_path), "%s", config.metrics_file);
+        written.len = 0;
+    }
+    if (written_path[0] == '\0') {
+        return;
+    }
+
+    contents.len = 0;
+    format_metrics(&contents);
+    if (contents.len == written.len && memcmp(contents.data, written.data, contents.len) == 0) {
+        return;
+    }
+    if (write_metrics_file(written_path, &contents)) {
+        written.len = 0;
+        buffer_append(&written, contents.data, contents.len);
+    }
+}
+
+void metrics_cleanup(void) {
+    if (written_path[0] != '\0') {
+        unlink(written_path);
+        written_path[0] = '\0';
+    }
+    buffer_free(&contents);
+    buffer_free(&written);
+}
@@ -2,22 +2,51 @@
 #include "config.h"
 #include "task.h"
 #include "error_report.h"
+#include "startup.h"
+#include "stats.h"
+#include "timekeeper.h"
+#include "thread.h"
 #include <X11/Xlib.h>
 #include <X11/Xft/Xft.h>
+#include <X11/extensions/Xrender.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <fontconfig/fontconfig.h>
 
 extern Display *dpy;
 extern Window win;
 extern GC gc;
 extern int screen;
 extern Visual *visual;
+extern int depth;
+extern int window_width;
+extern int window_height;
 extern XSetWindowAttributes attrs;
 
 static XftColor cached_text_color, cached_stroke_color;
 static XftFont *cached_font = NULL;
 static int colors_allocated = 0;
+static Picture window_picture = None;
+
+static Pixmap back_buffer = None;
+static XftDraw *back_draw = NULL;
+static int back_width = 0;
+static int back_height = 0;
+static XftDraw *scratch_draw = NULL;
+
+typedef struct {
+    char overlay_family[256];
+    double overlay_size;
+    int overlay_weight;
+    char menu_family[256];
+    double menu_size;
+} FontPreload;
+
+static FontPreload font_preload;
+static pthread_t font_thread;
+static int font_thread_running = 0;
 
 static int warning_logged = 0;
 static char last_task_name[256] = "";
@@ -25,8 +54,150 @@ static char last_task_name[256] = "";
 static int last_paused_state = -1;
 static int debug_logged = 0;
 
-int initialize_overlay_resources() {
+#define STROKE_WIDTH 1
+#define TEXT_CACHE_SIZE 24
+#define OVERLAY_TEXT_MAX 256
+
+enum {
+    SEG_TASK,
+    SEG_SEPARATOR,
+    SEG_TIME,
+    SEG_PAUSED,
+    SEG_COUNT
+};
+
+typedef struct {
+    char text[OVERLAY_TEXT_MAX];
+    int x;
+    int width;
+} OverlaySegment;
+
+typedef struct {
+    char text[OVERLAY_TEXT_MAX];
+    Pixmap pixmap;
+    Picture picture;
+    int width;
+    int height;
+    int origin_x;
+    int origin_y;
+    int x_off;
+    int ink_y;
+    int ink_height;
+    unsigned long last_used;
+} TextCacheEntry;
+
+static OverlaySegment shown[SEG_COUNT];
+static int shown_text_y = 0;
+static int frame_valid = 0;
+
+static TextCacheEntry text_cache[TEXT_CACHE_SIZE];
+static unsigned long text_cache_clock = 0;
+static unsigned long text_cache_hits = 0;
+static unsigned long text_cache_misses = 0;
+
+static unsigned long frames_drawn = 0;
+static unsigned long frame_requests = 0;
+static unsigned long frame_round_trips = 0;
+
+static void free_text_cache_entry(TextCacheEntry *entry) {
+    if (entry->picture != None) {
+        XRenderFreePicture(dpy, entry->picture);
+    }
+    if (entry->pixmap != None) {
+        XFreePixmap(dpy, entry->pixmap);
+    }
+    memset(entry, 0, sizeof(*entry));
+}
+
+static void flush_text_cache(void) {
+    for (int i = 0; i < TEXT_CACHE_SIZE; i++) {
+        if (text_cache[i].picture != None) {
+            free_text_cache_entry(&text_cache[i]);
+        }
+    }
+}
+
+static void evict_text(const char *text) {
+    for (int i = 0; i < TEXT_CACHE_SIZE; i++) {
+        if (text_cache[i].picture != None && strcmp(text_cache[i].text, text) == 0) {
+            free_text_cache_entry(&text_cache[i]);
+            return;
+        }
+    }
+}
+
+static void match_font(const char *family, double size, int weight) {
+    FcPattern *pattern = FcPatternCreate();
+    FcResult result;
+
+    if (!pattern) {
+        return;
+    }
+    FcPatternAddString(pattern, FC_FAMILY, (const FcChar8 *)family);
+    FcPatternAddDouble(pattern, FC_SIZE, size);
+    if (weight >= 0) {
+        FcPatternAddInteger(pattern, FC_WEIGHT, weight);
+    }
+    FcConfigSubstitute(NULL, pattern, FcMatchPattern);
+    FcDefaultSubstitute(pattern);
+
+    FcPattern *match = FcFontMatch(NULL, pattern, &result);
+    if (match) {
+        FcPatternDestroy(match);
+    }
+    FcPatternDestroy(pattern);
+}
+
+static void *run_font_preload(void *arg) {
+    FontPreload *preload = arg;
+    int64_t start = startup_now();
+    startup_set_thread("font");
+
+    int ok = FcInit();
+    startup_phase("FcInit", start);
+    if (!ok) {
+        LOG_WARNING("Failed to initialize fontconfig");
+    } else {
+        int64_t match_start = startup_now();
+        match_font(preload->overlay_family, preload->overlay_size, preload->overlay_weight);
+        match_font(preload->menu_family, preload->menu_size, -1);
+        startup_phase("font match", match_start);
+    }
+    startup_task_end("font cache", start);
+    return NULL;
+}
+
+void overlay_preload_fonts(void) {
+    snprintf(font_preload.overlay_family, sizeof(font_preload.overlay_family), "%s", config.font_name);
+    font_preload.overlay_size = config.font_size;
+    font_preload.overlay_weight = config.font_weight;
+    snprintf(font_preload.menu_family, sizeof(font_preload.menu_family), "%s", config.menu_font_name);
+    font_preload.menu_size = config.menu_font_size;
+    startup_task_begin();
+
+    int error = start_worker_thread(&font_thread, run_font_preload, &font_preload);
+
+    if (error != 0) {
+        LOG_WARNING("Failed to start font thread, fonts load on first use: %s", strerror(error));
+        startup_task_end("font cache", startup_now());
+        return;
+    }
+    font_thread_running = 1;
+}
+
+void overlay_wait_for_fonts(void) {
+    if (font_thread_running) {
+        pthread_join(font_thread, NULL);
+        font_thread_running = 0;
+    }
+}
+
+int initialize_overlay_resources(void) {
     if (!cached_font) {
+        int64_t start = startup_now();
+        overlay_wait_for_fonts();
+        startup_phase("wait for font cache", start);
+        start = startup_now();
         cached_font = XftFontOpen(dpy, screen,
                                   XFT_FAMILY, XftTypeString, config.font_name,
                                   XFT_SIZE, XftTypeDouble, config.font_size,
@@ -34,6 +205,7 @@ int initialize_overlay_resources() {
                                   XFT_ANTIALIAS, XftTypeBool, True,
                                   FC_HINTING, XftTypeBool, True,
                                   NULL);
+        startup_phase("font open", start);
         if (!cached_font) {
             LOG_ERROR("Failed to load font: %s, size %f", config.font_name, config.font_size);
             return 0;
@@ -52,10 +224,62 @@ int initialize_overlay_resources() {
         colors_allocated = 1;
     }
 
+    if (window_picture == None) {
+        XRenderPictFormat *format = XRenderFindVisualFormat(dpy, visual);
+        if (!format) {
+            LOG_ERROR("No XRender format for the overlay visual");
+            return 0;
+        }
+        window_picture = XRenderCreatePicture(dpy, win, format, 0, NULL);
+    }
+
+    return 1;
+}
+
+static void free_back_buffer(void) {
+    if (back_draw) {
+        XftDrawDestroy(back_draw);
+        back_draw = NULL;
+    }
+    if (back_buffer != None) {
+        XFreePixmap(dpy, back_buffer);
+        back_buffer = None;
+    }
+    back_width = 0;
+    back_height = 0;
+}
+
+static int ensure_back_buffer(int width, int height) {
+    if (back_draw && back_width == width && back_height == height) {
+        return 1;
+    }
+
+    free_back_buffer();
+    back_buffer = XCreatePixmap(dpy, win, width, height, depth);
+    back_draw = XftDrawCreate(dpy, back_buffer, visual, attrs.colormap);
+    if (!back_draw) {
+        LOG_ERROR("Failed to create XftDraw for the back buffer");
+        free_back_buffer();
+        return 0;
+    }
+    back_width = width;
+    back_height = height;
+    frame_valid = 0;
+    LOG_DEBUG("Back buffer resized to %dx%d", width, height);
     return 1;
 }
 
 void cleanup_overlay_resources() {
+    flush_text_cache();
+    free_back_buffer();
+    if (scratch_draw) {
+        XftDrawDestroy(scratch_draw);
+        scratch_draw = NULL;
+    }
+    if (window_picture != None) {
+        XRenderFreePicture(dpy, window_picture);
+        window_picture = None;
+    }
     if (cached_font) {
         XftFontClose(dpy, cached_font);
         cached_font = NULL;
@@ -65,11 +289,20 @@ void cleanup_overlay_resources() {
         XftColorFree(dpy, visual, attrs.colormap, &cached_stroke_color);
         colors_allocated = 0;
     }
+    frame_valid = 0;
+}
+
+void get_overlay_stats(OverlayStats *stats) {
+    stats->frames = frames_drawn;
+    stats->requests = frame_requests;
+    stats->round_trips = frame_round_trips;
+    stats->cache_hits = text_cache_hits;
+    stats->cache_misses = text_cache_misses;
 }
 
 void draw_stroke(const char* display_text, XftColor xftcolor, int text_x, int text_y, XftDraw *xftdraw) {
-    for (int dx = -1; dx <= 1; dx++) {
-        for (int dy = -1; dy <= 1; dy++) {
+    for (int dx = -STROKE_WIDTH; dx <= STROKE_WIDTH; dx++) {
+        for (int dy = -STROKE_WIDTH; dy <= STROKE_WIDTH; dy++) {
             if (dx != 0 || dy != 0) {
                 XftDrawStringUtf8(xftdraw, &xftcolor, cached_font, text_x + dx, text_y + dy, (XftChar8 *)display_text, strlen(display_text));
             }
@@ -77,6 +310,118 @@ void draw_stroke(const char* display_text, XftColor xftcolor, int text_x, int te
     }
 }
 
+static int render_text_entry(TextCacheEntry *entry, const char *text) {
+    XGlyphInfo extents;
+    XftTextExtentsUtf8(dpy, cached_font, (XftChar8 *)text, strlen(text), &extents);
+
+    strncpy(entry->text, text, sizeof(entry->text) - 1);
+    entry->text[sizeof(entry->text) - 1] = '\0';
+    entry->width = (extents.width > 0 ? extents.width : 1) + 2 * STROKE_WIDTH;
+    entry->height = (extents.height > 0 ? extents.height : 1) + 2 * STROKE_WIDTH;
+    entry->origin_x = extents.x + STROKE_WIDTH;
+    entry->origin_y = extents.y + STROKE_WIDTH;
+    entry->x_off = extents.xOff;
+    entry->ink_y = extents.y;
+    entry->ink_height = extents.height;
+
+    entry->pixmap = XCreatePixmap(dpy, win, entry->width, entry->height, 32);
+    entry->picture = XRenderCreatePicture(dpy, entry->pixmap,
+                                          XRenderFindStandardFormat(dpy, PictStandardARGB32), 0, NULL);
+
+    XRenderColor transparent = {0, 0, 0, 0};
+    XRenderFillRectangle(dpy, PictOpSrc, entry->picture, &transparent, 0, 0, entry->width, entry->height);
+
+    if (scratch_draw) {
+        XftDrawChange(scratch_draw, entry->pixmap);
+    } else {
+        scratch_draw = XftDrawCreate(dpy, entry->pixmap, visual, attrs.colormap);
+        if (!scratch_draw) {
+            LOG_ERROR("Failed to create XftDraw for text cache");
+            free_text_cache_entry(entry);
+            return 0;
+        }
+    }
+    draw_stroke(text, cached_stroke_color, entry->origin_x, entry->origin_y, scratch_draw);
+    XftDrawStringUtf8(scratch_draw, &cached_text_color, cached_font, entry->origin_x, entry->origin_y,
+                      (XftChar8 *)text, strlen(text));
+    return 1;
+}
+
+static TextCacheEntry *lookup_text(const char *text) {
+    TextCacheEntry *victim = &text_cache[0];
+
+    for (int i = 0; i < TEXT_CACHE_SIZE; i++) {
+        TextCacheEntry *entry = &text_cache[i];
+        if (entry->picture != None && strcmp(entry->text, text) == 0) {
+            entry->last_used = ++text_cache_clock;
+            text_cache_hits++;
+            return entry;
+        }
+        if (victim->picture != None && (entry->picture == None || entry->last_used < victim->last_used)) {
+            victim = entry;
+        }
+    }
+
+    text_cache_misses++;
+    if (victim->picture != None) {
+        free_text_cache_entry(victim);
+    }
+    if (!render_text_entry(victim, text)) {
+        return NULL;
+    }
+    victim->last_used = ++text_cache_clock;
+    LOG_DEBUG("Text cache miss: '%s' (%lu hits, %lu misses)", text, text_cache_hits, text_cache_misses);
+    return victim;
+}
+
+static int is_glyph_segment(int index) {
+    return index == SEG_TIME;
+}
+
+static int measure_segment(int index, const char *text) {
+    if (text[0] == '\0') {
+        return 0;
+    }
+    if (!is_glyph_segment(index)) {
+        TextCacheEntry *entry = lookup_text(text);
+        return entry ? entry->x_off : 0;
+    }
+
+    int width = 0;
+    for (const char *c = text; *c; c++) {
+        char glyph[2] = {*c, '\0'};
+        TextCacheEntry *entry = lookup_text(glyph);
+        width += entry ? entry->x_off : 0;
+    }
+    return width;
+}
+
+static void composite_text(TextCacheEntry *entry, int x, int text_y) {
+    XRenderComposite(dpy, PictOpOver, entry->picture, None, XftDrawPicture(back_draw),
+                     0, 0, 0, 0, x - entry->origin_x, text_y - entry->origin_y,
+                     entry->width, entry->height);
+}
+
+static void draw_segment(int index, const OverlaySegment *segment, int text_y) {
+    if (!is_glyph_segment(index)) {
+        TextCacheEntry *entry = lookup_text(segment->text);
+        if (entry) {
+            composite_text(entry, segment->x, text_y);
+        }
+        return;
+    }
+
+    int x = segment->x;
+    for (const char *c = segment->text; *c; c++) {
+        char glyph[2] = {*c, '\0'};
+        TextCacheEntry *entry = lookup_text(glyph);
+        if (entry) {
+            composite_text(entry, x, text_y);
+            x += entry->x_off;
+        }
+    }
+}
+
 void format_time(int seconds, char *buffer, size_t bufsize) {
     int hours = seconds / 3600;
     int minutes = (seconds % 3600) / 60;
@@ -89,94 +434,159 @@ void format_time(int seconds, char *buffer, size_t bufsize) {
     }
 }
 
-void draw_overlay(int is_paused, time_t elapsed_time) {
-    XWindowAttributes wa;
-    if (XGetWindowAttributes(dpy, win, &wa) == 0) {
-        LOG_ERROR("Failed to get window attributes");
+void overlay_invalidate(void) {
+    frame_valid = 0;
+}
+
+void overlay_apply_config(const ChronoTaskConfig *previous) {
+    int font_changed = strcmp(previous->font_name, config.font_name) != 0 ||
+                       previous->font_size != config.font_size ||
+                       previous->font_weight != config.font_weight;
+    int colors_changed = memcmp(&previous->text_color, &config.text_color, sizeof(Color)) != 0 ||
+                         memcmp(&previous->stroke_color, &config.stroke_color, sizeof(Color)) != 0;
+
+    if (!font_changed && !colors_changed) {
         return;
     }
-    int width = wa.width;
-    int height = wa.height;
 
-    if (!initialize_overlay_resources()) {
-        LOG_ERROR("Failed to initialize overlay resources");
-        return;
+    flush_text_cache();
+    if (font_changed && cached_font) {
+        XftFontClose(dpy, cached_font);
+        cached_font = NULL;
     }
+    if (colors_changed && colors_allocated) {
+        XftColorFree(dpy, visual, attrs.colormap, &cached_text_color);
+        XftColorFree(dpy, visual, attrs.colormap, &cached_stroke_color);
+        colors_allocated = 0;
+    }
+    frame_valid = 0;
+    LOG_INFO("Overlay %s%s%s changed, rebuilding", font_changed ? "font" : "",
+             font_changed && colors_changed ? " and " : "", colors_changed ? "colors" : "");
+}
 
-    XSetForeground(dpy, gc, 0x00000000);
-    XClearWindow(dpy, win);
+void draw_overlay(int is_paused, int remaining_seconds) {
 
-    int remaining = get_current_task_duration() - elapsed_time;
-    
-    char time_str[20];
-    format_time(remaining, time_str, sizeof(time_str));
-    
-    const char* task_name = get_current_task_name();
-    const char* separator = " - ";
-    const char* paused_text = is_paused ? " (PAUSED)" : "";
+    OverlaySegment frame[SEG_COUNT];
+    memset(frame, 0, sizeof(frame));
+    strncpy(frame[SEG_TASK].text, get_current_task_name(), sizeof(frame[SEG_TASK].text) - 1);
+    strcpy(frame[SEG_SEPARATOR].text, " - ");
+    format_time(remaining_seconds, frame[SEG_TIME].text, sizeof(frame[SEG_TIME].text));
+    strcpy(frame[SEG_PAUSED].text, is_paused ? " (PAUSED)" : "");
 
-    XftDraw *xftdraw = XftDrawCreate(dpy, win, visual, attrs.colormap);
-    if (!xftdraw) {
-        LOG_ERROR("Failed to create XftDraw");
-        return;
+    if (frame_valid) {
+        int changed = 0;
+        for (int i = 0; i < SEG_COUNT; i++) {
+            if (strcmp(frame[i].text, shown[i].text) != 0) {
+                changed = 1;
+                break;
+            }
+        }
+        if (!changed) {
+            return;
+        }
     }
 
-    XGlyphInfo extents_task, extents_separator, extents_time, extents_paused;
-    XftTextExtentsUtf8(dpy, cached_font, (XftChar8 *)task_name, strlen(task_name), &extents_task);
-    XftTextExtentsUtf8(dpy, cached_font, (XftChar8 *)separator, strlen(separator), &extents_separator);
-    XftTextExtentsUtf8(dpy, cached_font, (XftChar8 *)time_str, strlen(time_str), &extents_time);
-    XftTextExtentsUtf8(dpy, cached_font, (XftChar8 *)paused_text, strlen(paused_text), &extents_paused); 
+    int64_t render_start = now_ns();
+    unsigned long first_request = NextRequest(dpy);
+    unsigned long last_reply = LastKnownRequestProcessed(dpy);
+    int width = window_width;
+    int height = window_height;
+
+    if (!initialize_overlay_resources() || !ensure_back_buffer(width, height)) {
+        LOG_ERROR("Failed to initialize overlay resources");
+        return;
+    }
 
-    if (strcmp(last_task_name, task_name) != 0) {
-        strncpy(last_task_name, task_name, sizeof(last_task_name) - 1);
+    if (strcmp(last_task_name, frame[SEG_TASK].text) != 0) {
+        if (last_task_name[0] != '\0') {
+            evict_text(last_task_name);
+        }
+        strncpy(last_task_name, frame[SEG_TASK].text, sizeof(last_task_name) - 1);
         last_task_name[sizeof(last_task_name) - 1] = '\0';
         warning_logged = 0;
+        debug_logged = 0;
     }
 
-    if (!warning_logged && (extents_task.width == 0 || extents_separator.width == 0 || 
-        extents_time.width == 0 || extents_paused.width == 0)) {
-        LOG_WARNING("One or more text extents have zero width. This might indicate a problem with the font or text.");
-        warning_logged = 1;
+    int total_width = 0;
+    for (int i = 0; i < SEG_COUNT; i++) {
+        frame[i].width = measure_segment(i, frame[i].text);
+        total_width += frame[i].width;
     }
 
-    int total_width = extents_task.xOff + extents_separator.xOff + extents_time.xOff + extents_paused.xOff;
-    int total_height = extents_task.height;
+    TextCacheEntry *task_entry = lookup_text(frame[SEG_TASK].text);
+    if (!task_entry) {
+        frame_valid = 0;
+        return;
+    }
 
-    int text_x, text_y;
-    text_x = (width - total_width) / 2;
-    text_y = (height + total_height) / 2 - extents_task.y;
+    if (!warning_logged && (frame[SEG_TASK].width == 0 || frame[SEG_SEPARATOR].width == 0 ||
+        frame[SEG_TIME].width == 0 || (is_paused && frame[SEG_PAUSED].width == 0))) {
+        LOG_WARNING("One or more text extents have zero width. This might indicate a problem with the font or text.");
+        warning_logged = 1;
+    }
 
+    int text_x = (width - total_width) / 2;
+    int text_y = (height + task_entry->ink_height) / 2 - task_entry->ink_y;
+    for (int i = 0; i < SEG_COUNT; i++) {
+        frame[i].x = text_x;
+        text_x += frame[i].width;
+    }
 
-    draw_stroke(task_name, cached_stroke_color, text_x, text_y, xftdraw);
-    XftDrawStringUtf8(xftdraw, &cached_text_color, cached_font, text_x, text_y, (XftChar8 *)task_name, strlen(task_name));
-    text_x += extents_task.xOff;
+    int first_dirty = 0;
+    if (frame_valid && text_y == shown_text_y) {
+        while (first_dirty < SEG_COUNT &&
+               frame[first_dirty].x == shown[first_dirty].x &&
+               strcmp(frame[first_dirty].text, shown[first_dirty].text) == 0) {
+            first_dirty++;
+        }
+    }
 
-    draw_stroke(separator, cached_stroke_color, text_x, text_y, xftdraw);
-    XftDrawStringUtf8(xftdraw, &cached_text_color, cached_font, text_x, text_y, (XftChar8 *)separator, strlen(separator));
-    text_x += extents_separator.xOff;
+    int damage_x = 0, damage_y = 0, damage_width = width, damage_height = height;
+    if (first_dirty > 0) {
+        int old_end = shown[SEG_COUNT - 1].x + shown[SEG_COUNT - 1].width;
+        int new_end = frame[SEG_COUNT - 1].x + frame[SEG_COUNT - 1].width;
+        int damage_end = (old_end > new_end ? old_end : new_end) + STROKE_WIDTH;
+        damage_x = frame[first_dirty].x - STROKE_WIDTH;
+        damage_y = text_y - cached_font->ascent - STROKE_WIDTH;
+        damage_width = damage_end - damage_x;
+        damage_height = cached_font->ascent + cached_font->descent + 2 * STROKE_WIDTH;
+    }
 
-    draw_stroke(time_str, cached_stroke_color, text_x, text_y, xftdraw);
-    XftDrawStringUtf8(xftdraw, &cached_text_color, cached_font, text_x, text_y, (XftChar8 *)time_str, strlen(time_str));
-    text_x += extents_time.xOff;
+    Picture back_picture = XftDrawPicture(back_draw);
+    XRenderColor transparent = {0, 0, 0, 0};
+    XRenderFillRectangle(dpy, PictOpSrc, back_picture, &transparent,
+                         damage_x, damage_y, damage_width, damage_height);
 
-    if (is_paused) {
-        draw_stroke(paused_text, cached_stroke_color, text_x, text_y, xftdraw);
-        XftDrawStringUtf8(xftdraw, &cached_text_color, cached_font, text_x, text_y, (XftChar8 *)paused_text, strlen(paused_text));
+    for (int i = first_dirty; i < SEG_COUNT; i++) {
+        if (frame[i].text[0] != '\0') {
+            draw_segment(i, &frame[i], text_y);
+        }
     }
-    XftDrawDestroy(xftdraw);
 
+    XRenderComposite(dpy, PictOpSrc, back_picture, None, window_picture,
+                     damage_x, damage_y, 0, 0, damage_x, damage_y, damage_width, damage_height);
 
-    if (strcmp(last_task_name, task_name) != 0 || last_paused_state != is_paused) {
-        strncpy(last_task_name, task_name, sizeof(last_task_name) - 1);
-        last_task_name[sizeof(last_task_name) - 1] = '\0';
+    memcpy(shown, frame, sizeof(shown));
+    shown_text_y = text_y;
+    frame_valid = 1;
+
+    if (last_paused_state != is_paused) {
         last_paused_state = is_paused;
         debug_logged = 0;
     }
-    
+
     if (!debug_logged) {
-        LOG_DEBUG("Overlay updated - Task: %s, State: %s", task_name, is_paused ? "Paused" : "Running");
+        LOG_DEBUG("Overlay updated - Task: %s, State: %s", frame[SEG_TASK].text, is_paused ? "Paused" : "Running");
         debug_logged = 1;
     }
 
+    frames_drawn++;
+    frame_requests += NextRequest(dpy) - first_request;
+    if (LastKnownRequestProcessed(dpy) != last_reply) {
+        frame_round_trips++;
+        LOG_DEBUG("Overlay frame waited on a server reply (%lu of %lu frames)", frame_round_trips, frames_drawn);
+    }
+
     XFlush(dpy);
+    stats_frame(now_ns() - render_start);
 }
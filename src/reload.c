@@ -0,0 +1,272 @@
+#include "reload.h"
+#include "config.h"
+#include "task.h"
+#include "overlay.h"
+#include "audio.h"
+#include "error_report.h"
+#include "thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#define RELOAD_WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM)
+
+typedef struct {
+    char config_path[PATH_MAX];
+    char routines_path[PATH_MAX];
+    int reload_config;
+    int reload_routines;
+    int config_ok;
+    int routines_ok;
+    ChronoTaskConfig config;
+    RoutineList routines;
+} ReloadJob;
+
+static int inotify_fd = -1;
+static int done_fd = -1;
+static int config_wd = -1;
+static int routines_wd = -1;
+static char config_path[PATH_MAX];
+static char routines_path[PATH_MAX];
+static int routines_is_dir = 0;
+
+static int pending_config = 0;
+static int pending_routines = 0;
+static pthread_t reload_thread;
+static int reload_running = 0;
+static ReloadJob job;
+
+static const char *base_name(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+static int add_watch(const char *path, int whole_dir) {
+    char dir[PATH_MAX];
+    const char *slash = strrchr(path, '/');
+
+    if (whole_dir) {
+        snprintf(dir, sizeof(dir), "%s", path);
+    } else if (slash == path) {
+        snprintf(dir, sizeof(dir), "/");
+    } else if (slash) {
+        snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path), path);
+    } else {
+        snprintf(dir, sizeof(dir), ".");
+    }
+
+    int wd = inotify_add_watch(inotify_fd, dir, RELOAD_WATCH_MASK);
+    if (wd == -1) {
+        LOG_WARNING("Failed to watch %s: %s", dir, strerror(errno));
+    }
+    return wd;
+}
+
+static void update_watches(void) {
+    struct stat st;
+
+    if (routines_wd != -1 && routines_wd != config_wd) {
+        inotify_rm_watch(inotify_fd, routines_wd);
+    }
+    routines_is_dir = stat(routines_path, &st) == 0 && S_ISDIR(st.st_mode);
+    routines_wd = add_watch(routines_path, routines_is_dir);
+    LOG_INFO("Watching %s and %s for changes", config_path, routines_path);
+}
+
+int reload_init(const char *config_file) {
+    snprintf(routines_path, sizeof(routines_path), "%s", get_routines_path());
+    if (!get_config_path(config_file, config_path, sizeof(config_path)) || routines_path[0] == '\0') {
+        LOG_WARNING("Could not resolve configuration paths, hot reload disabled");
+        return 0;
+    }
+
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    done_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotify_fd == -1 || done_fd == -1) {
+        LOG_WARNING("Failed to set up hot reload: %s", strerror(errno));
+        reload_cleanup();
+        return 0;
+    }
+
+    config_wd = add_watch(config_path, 0);
+    update_watches();
+    return 1;
+}
+
+int reload_fill_pollfds(struct pollfd *fds, int max_fds) {
+    if (inotify_fd == -1 || max_fds < RELOAD_POLL_FDS) {
+        return 0;
+    }
+    fds[0] = (struct pollfd){ .fd = inotify_fd, .events = POLLIN };
+    fds[1] = (struct pollfd){ .fd = done_fd, .events = POLLIN };
+    return RELOAD_POLL_FDS;
+}
+
+static int is_routine_file(const char *name) {
+    size_t len = strlen(name);
+    return name[0] != '.' && len > 5 && strcmp(name + len - 5, ".yaml") == 0;
+}
+
+static void read_watch_events(void) {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+
+    while ((len = read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+        for (char *p = buffer; p < buffer + len; ) {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + event->len;
+            if (event->len == 0) {
+                continue;
+            }
+
+            if (event->wd == config_wd && strcmp(event->name, base_name(config_path)) == 0 &&
+                (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))) {
+                pending_config = 1;
+            }
+            if (event->wd == routines_wd &&
+                (routines_is_dir ? is_routine_file(event->name)
+                                 : strcmp(event->name, base_name(routines_path)) == 0 &&
+                                   (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)))) {
+                pending_routines = 1;
+            }
+        }
+    }
+    if (len == -1 && errno != EAGAIN) {
+        LOG_WARNING("Failed to read file change events: %s", strerror(errno));
+    }
+}
+
+static void *run_reload(void *arg) {
+    ReloadJob *reload = arg;
+    uint64_t done = 1;
+
+    if (reload->reload_config) {
+        reload->config_ok = load_config_file(reload->config_path, &reload->config);
+    }
+    if (reload->reload_routines) {
+        reload->routines_ok = load_routines_from(reload->routines_path, &reload->routines);
+    }
+
+    if (write(done_fd, &done, sizeof(done)) == -1) {
+        LOG_ERROR("Failed to signal reload completion: %s", strerror(errno));
+    }
+    return NULL;
+}
+
+static void start_reload(void) {
+    memset(&job, 0, sizeof(job));
+    snprintf(job.config_path, sizeof(job.config_path), "%s", config_path);
+    snprintf(job.routines_path, sizeof(job.routines_path), "%s", routines_path);
+    job.reload_config = pending_config;
+    job.reload_routines = pending_routines;
+    pending_config = 0;
+    pending_routines = 0;
+
+    int error = start_worker_thread(&reload_thread, run_reload, &job);
+
+    if (error != 0) {
+        LOG_WARNING("Failed to start reload thread: %s", strerror(error));
+        return;
+    }
+    reload_running = 1;
+}
+
+void reload_apply_config(const ChronoTaskConfig *fresh) {
+    ChronoTaskConfig previous = config;
+
+    config = *fresh;
+    for (int i = 0; i < config_key_count; i++) {
+        const ConfigKey *key = &config_keys[i];
+        char *field = (char *)&config + key->offset;
+        const char *kept = (const char *)&previous + key->offset;
+        if (key->apply == CONFIG_RESTART && memcmp(field, kept, key->size) != 0) {
+            LOG_WARNING("%s only takes effect after a restart", key->name);
+            memcpy(field, kept, key->size);
+        }
+    }
+    overlay_apply_config(&previous);
+
+    if (strcmp(previous.notification_sound, config.notification_sound) != 0) {
+        load_notification_sound();
+    }
+    if (strcmp(previous.routines, config.routines) != 0) {
+        if (resolve_routines_path(config.routines, routines_path, sizeof(routines_path))) {
+            update_watches();
+            pending_routines = 1;
+        }
+    }
+}
+
+static int finish_reload(void) {
+    uint64_t done;
+    int swapped = 0;
+
+    if (read(done_fd, &done, sizeof(done)) == -1 || !reload_running) {
+        return 0;
+    }
+    pthread_join(reload_thread, NULL);
+    reload_running = 0;
+
+    if (job.reload_config) {
+        if (job.config_ok) {
+            reload_apply_config(&job.config);
+            LOG_INFO("Configuration reloaded from %s", job.config_path);
+        } else {
+            LOG_WARNING("Keeping the current configuration, %s could not be loaded", job.config_path);
+        }
+    }
+    if (job.reload_routines) {
+        if (job.routines_ok && replace_routines(&job.routines)) {
+            LOG_INFO("Routines reloaded from %s", job.routines_path);
+            swapped = 1;
+        } else if (!job.routines_ok) {
+            LOG_WARNING("Keeping the current routines, %s could not be loaded", job.routines_path);
+        }
+        free_routines(&job.routines);
+    }
+    return swapped;
+}
+
+int reload_handle_events(const struct pollfd *fds, int nfds) {
+    int swapped = 0;
+
+    if (nfds < RELOAD_POLL_FDS) {
+        return 0;
+    }
+    if (fds[0].revents & POLLIN) {
+        read_watch_events();
+    }
+    if (fds[1].revents & POLLIN) {
+        swapped = finish_reload();
+    }
+    if (!reload_running && (pending_config || pending_routines)) {
+        start_reload();
+    }
+    return swapped;
+}
+
+void reload_cleanup(void) {
+    if (reload_running) {
+        pthread_join(reload_thread, NULL);
+        free_routines(&job.routines);
+        reload_running = 0;
+    }
+    if (inotify_fd != -1) {
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+    if (done_fd != -1) {
+        close(done_fd);
+        done_fd = -1;
+    }
+    config_wd = -1;
+    routines_wd = -1;
+}
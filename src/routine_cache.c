@@ -0,0 +1,242 @@
+#define _GNU_SOURCE
+#include "routine_cache.h"
+#include "error_report.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+static uint64_t checksum_bytes(uint64_t hash, const void *data, size_t len) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+static size_t align8(size_t value) {
+    return (value + 7) & ~(size_t)7;
+}
+
+static int cache_path_for(const char *source_path, char *path, size_t size, int create) {
+    const char *cache_home = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    char base[PATH_MAX];
+    char dir[PATH_MAX];
+
+    if (cache_home && cache_home[0] != '\0') {
+        snprintf(base, sizeof(base), "%s", cache_home);
+        snprintf(dir, sizeof(dir), "%s/chronotask", cache_home);
+    } else if (home) {
+        snprintf(base, sizeof(base), "%s/.cache", home);
+        snprintf(dir, sizeof(dir), "%s/.cache/chronotask", home);
+    } else {
+        return 0;
+    }
+
+    if (create && ((mkdir(base, 0755) == -1 && errno != EEXIST) ||
+                   (mkdir(dir, 0755) == -1 && errno != EEXIST))) {
+        LOG_WARNING("Failed to create cache directory %s: %s", dir, strerror(errno));
+        return 0;
+    }
+
+    snprintf(path, size, "%s/routines-%016llx.cache", dir,
+             (unsigned long long)checksum_bytes(FNV_OFFSET, source_path, strlen(source_path)));
+    return 1;
+}
+
+static int offsets_in_bounds(const char *arena, uint64_t offset, int32_t count, uint64_t arena_size) {
+    const uint32_t *strings = (const uint32_t*)(arena + offset);
+    for (int32_t i = 0; i < count; i++) {
+        if (strings[i] >= arena_size) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int records_in_bounds(const RoutineCacheHeader *header, const RoutineRecord *records, const char *arena) {
+    if (header->arena_size == 0 || arena[header->arena_size - 1] != '\0') {
+        return 0;
+    }
+    for (uint32_t i = 0; i < header->routine_count; i++) {
+        const RoutineRecord *record = &records[i];
+        uint64_t task_bytes = (uint64_t)(uint32_t)record->task_count * sizeof(uint32_t);
+        if (record->task_count < 0 || record->name >= header->arena_size ||
+            record->sound >= header->arena_size || record->complete_sound >= header->arena_size ||
+            record->warning_sound >= header->arena_size ||
+            record->task_names % sizeof(uint32_t) != 0 || record->durations % sizeof(int32_t) != 0 ||
+            record->task_sounds % sizeof(uint32_t) != 0 ||
+            record->task_names + task_bytes > header->arena_size ||
+            record->durations + task_bytes > header->arena_size ||
+            record->task_sounds + task_bytes > header->arena_size ||
+            !offsets_in_bounds(arena, record->task_names, record->task_count, header->arena_size) ||
+            !offsets_in_bounds(arena, record->task_sounds, record->task_count, header->arena_size)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int validate_cache(const char *mapping, size_t size, const char *source_path, const struct stat *source) {
+    const RoutineCacheHeader *header = (const RoutineCacheHeader*)mapping;
+    size_t path_len = strlen(source_path);
+
+    if (header->magic != ROUTINE_CACHE_MAGIC || header->version != ROUTINE_CACHE_VERSION ||
+        header->header_size != sizeof(RoutineCacheHeader) || header->record_size != sizeof(RoutineRecord)) {
+        return 0;
+    }
+    if (header->source_size != (uint64_t)source->st_size ||
+        header->source_mtime_sec != (int64_t)source->st_mtim.tv_sec ||
+        header->source_mtime_nsec != (int64_t)source->st_mtim.tv_nsec) {
+        return 0;
+    }
+    if (header->path_len != path_len || sizeof(RoutineCacheHeader) + path_len > size ||
+        memcmp(mapping + sizeof(RoutineCacheHeader), source_path, path_len) != 0) {
+        return 0;
+    }
+
+    uint64_t records_size = (uint64_t)header->routine_count * sizeof(RoutineRecord);
+    if (header->records_offset != align8(sizeof(RoutineCacheHeader) + path_len) ||
+        header->arena_offset != header->records_offset + records_size ||
+        header->arena_offset > size || header->arena_size != size - header->arena_offset) {
+        return 0;
+    }
+
+    uint64_t checksum = checksum_bytes(FNV_OFFSET, mapping + sizeof(RoutineCacheHeader),
+                                       size - sizeof(RoutineCacheHeader));
+    if (checksum != header->checksum) {
+        LOG_WARNING("Routine cache checksum mismatch, ignoring cache");
+        return 0;
+    }
+
+    return records_in_bounds(header, (const RoutineRecord*)(mapping + header->records_offset),
+                             mapping + header->arena_offset);
+}
+
+int routine_cache_load(const char *source_path, RoutineList *list) {
+    struct stat source;
+    struct stat st;
+    char path[PATH_MAX];
+
+    if (stat(source_path, &source) == -1 || !cache_path_for(source_path, path, sizeof(path), 0)) {
+        return 0;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        LOG_DEBUG("No routine cache at %s", path);
+        return 0;
+    }
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(RoutineCacheHeader)) {
+        close(fd);
+        return 0;
+    }
+
+    void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        LOG_WARNING("Failed to map routine cache %s: %s", path, strerror(errno));
+        return 0;
+    }
+
+    if (!validate_cache(mapping, st.st_size, source_path, &source)) {
+        LOG_INFO("Routine cache %s is stale, reparsing %s", path, source_path);
+        munmap(mapping, st.st_size);
+        return 0;
+    }
+
+    const RoutineCacheHeader *header = mapping;
+    list->mapping = mapping;
+    list->mapping_size = st.st_size;
+    list->records = (RoutineRecord*)((char*)mapping + header->records_offset);
+    list->routine_count = header->routine_count;
+    list->routine_capacity = header->routine_count;
+    list->arena.data = (char*)mapping + header->arena_offset;
+    list->arena.used = header->arena_size;
+    LOG_DEBUG("Mapped routine cache %s (%zu bytes)", path, list->mapping_size);
+    return 1;
+}
+
+int routine_cache_store(const char *source_path, const struct stat *source, const RoutineList *list) {
+    char path[PATH_MAX];
+    char temp_path[PATH_MAX + 32];
+
+    if (!cache_path_for(source_path, path, sizeof(path), 1)) {
+        return 0;
+    }
+
+    size_t path_len = strlen(source_path);
+    size_t records_offset = align8(sizeof(RoutineCacheHeader) + path_len);
+    size_t records_size = (size_t)list->routine_count * sizeof(RoutineRecord);
+    size_t arena_offset = records_offset + records_size;
+    size_t arena_size = list->arena.used + 1;
+    size_t total = arena_offset + arena_size;
+
+    char *buffer = calloc(1, total);
+    if (!buffer) {
+        return 0;
+    }
+
+    RoutineCacheHeader *header = (RoutineCacheHeader*)buffer;
+    header->magic = ROUTINE_CACHE_MAGIC;
+    header->version = ROUTINE_CACHE_VERSION;
+    header->header_size = sizeof(RoutineCacheHeader);
+    header->record_size = sizeof(RoutineRecord);
+    header->source_size = source->st_size;
+    header->source_mtime_sec = source->st_mtim.tv_sec;
+    header->source_mtime_nsec = source->st_mtim.tv_nsec;
+    header->path_len = path_len;
+    header->routine_count = list->routine_count;
+    header->records_offset = records_offset;
+    header->arena_offset = arena_offset;
+    header->arena_size = arena_size;
+    memcpy(buffer + sizeof(RoutineCacheHeader), source_path, path_len);
+    memcpy(buffer + records_offset, list->records, records_size);
+    memcpy(buffer + arena_offset, list->arena.data, list->arena.used);
+    header->checksum = checksum_bytes(FNV_OFFSET, buffer + sizeof(RoutineCacheHeader),
+                                      total - sizeof(RoutineCacheHeader));
+
+    snprintf(temp_path, sizeof(temp_path), "%s.XXXXXX", path);
+    int fd = mkostemp(temp_path, O_CLOEXEC);
+    if (fd != -1 && fchmod(fd, 0644) == -1) {
+        close(fd);
+        unlink(temp_path);
+        fd = -1;
+    }
+    if (fd == -1) {
+        LOG_WARNING("Failed to create routine cache %s: %s", temp_path, strerror(errno));
+        free(buffer);
+        return 0;
+    }
+
+    size_t written = 0;
+    while (written < total) {
+        ssize_t n = write(fd, buffer + written, total - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        written += n;
+    }
+    free(buffer);
+
+    if (close(fd) == -1 || written != total || rename(temp_path, path) == -1) {
+        LOG_WARNING("Failed to write routine cache %s: %s", path, strerror(errno));
+        unlink(temp_path);
+        return 0;
+    }
+
+    LOG_INFO("Wrote routine cache %s (%zu bytes)", path, total);
+    return 1;
+}
@@ -1,5 +1,6 @@
 #include "routine_selector.h"
 #include "config.h"
+#include "overlay.h"
 #include "error_report.h"
 #include <X11/Xlib.h>
 #include <X11/Xft/Xft.h>
@@ -24,11 +25,6 @@ static XftColor text_color, highlight_color, bg_color;
 static int selected_index = 0;
 
 static void create_window(int height) {
-    dpy = XOpenDisplay(NULL);
-    if (!dpy) {
-        LOG_FATAL("Cannot open display");
-    }
-
     screen = DefaultScreen(dpy);
 
     win = XCreateSimpleWindow(dpy, RootWindow(dpy, screen),
@@ -54,6 +50,7 @@ static void init_font_and_colors() {
     Visual *visual = DefaultVisual(dpy, screen);
     Colormap cmap = DefaultColormap(dpy, screen);
 
+    overlay_wait_for_fonts();
     font = XftFontOpen(dpy, screen,
                        XFT_FAMILY, XftTypeString, config.menu_font_name,
                        XFT_SIZE, XftTypeDouble, config.menu_font_size,
@@ -135,9 +132,10 @@ static int handle_events(RoutineList *routines) {
     }
 }
 
-int select_routine_gui(RoutineList *routines) {
+int select_routine_gui(Display *display, RoutineList *routines) {
     int height = routines->routine_count * ROUTINE_HEIGHT;
 
+    dpy = display;
     create_window(height);
     init_font_and_colors();
 
@@ -147,7 +145,8 @@ int select_routine_gui(RoutineList *routines) {
     XftFontClose(dpy, font);
     XFreeGC(dpy, gc);
     XDestroyWindow(dpy, win);
-    XCloseDisplay(dpy);
+    XSync(dpy, True);
+    dpy = NULL;
 
     return selected;
 }
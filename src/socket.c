@@ -1,14 +1,81 @@
+#define _GNU_SOURCE
 #include "socket.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
 #include <errno.h>
 #include <unistd.h>
 #include <string.h>
+#include <fcntl.h>
 
 #ifndef CHRONOTASK_CTRL
 #include "error_report.h"
+#include "timekeeper.h"
 #endif
 
-int create_socket(void) {
+static int buffer_reserve(Buffer *buffer, size_t extra) {
+    if (buffer->len + extra + 1 <= buffer->cap) {
+        return 1;
+    }
+    size_t cap = buffer->cap ? buffer->cap : 256;
+    while (cap < buffer->len + extra + 1) {
+        cap *= 2;
+    }
+    char *grown = realloc(buffer->data, cap);
+    if (!grown) {
+        return 0;
+    }
+    buffer->data = grown;
+    buffer->cap = cap;
+    return 1;
+}
+
+int buffer_append(Buffer *buffer, const char *data, size_t len) {
+    if (!buffer_reserve(buffer, len)) {
+        return 0;
+    }
+    memcpy(buffer->data + buffer->len, data, len);
+    buffer->len += len;
+    buffer->data[buffer->len] = '\0';
+    return 1;
+}
+
+int buffer_printf(Buffer *buffer, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int needed = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (needed < 0 || !buffer_reserve(buffer, needed)) {
+        return 0;
+    }
+
+    va_start(args, format);
+    vsnprintf(buffer->data + buffer->len, needed + 1, format, args);
+    va_end(args);
+    buffer->len += needed;
+    return 1;
+}
+
+void buffer_consume(Buffer *buffer, size_t len) {
+    if (len >= buffer->len) {
+        buffer->len = 0;
+    } else {
+        memmove(buffer->data, buffer->data + len, buffer->len - len);
+        buffer->len -= len;
+    }
+    if (buffer->data) {
+        buffer->data[buffer->len] = '\0';
+    }
+}
+
+void buffer_free(Buffer *buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->len = 0;
+    buffer->cap = 0;
+}
+
+int create_socket(int backlog) {
     int server_socket = socket(AF_UNIX, SOCK_STREAM, 0);
     if (server_socket == -1) {
         #ifndef CHRONOTASK_CTRL
@@ -35,7 +102,7 @@ int create_socket(void) {
         return -1;
     }
 
-    if (listen(server_socket, 5) == -1) {
+    if (listen(server_socket, backlog) == -1) {
         #ifndef CHRONOTASK_CTRL
         LOG_ERROR("Failed to listen on socket: %s", strerror(errno));
         #else
@@ -52,7 +119,7 @@ int create_socket(void) {
 }
 
 int accept_connection(int server_socket) {
-    int client_socket = accept(server_socket, NULL, NULL);
+    int client_socket = accept4(server_socket, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
     if (client_socket == -1) {
         if (errno != EAGAIN && errno != EWOULDBLOCK) {
             #ifndef CHRONOTASK_CTRL
@@ -70,34 +137,337 @@ int accept_connection(int server_socket) {
 }
 
 int send_message(int socket, const char *message) {
-    ssize_t bytes_sent = send(socket, message, strlen(message), 0);
-    if (bytes_sent == -1) {
-        #ifndef CHRONOTASK_CTRL
-        LOG_ERROR("Send failed: %s", strerror(errno));
-        #else
-        fprintf(stderr, "Send failed: %s\n", strerror(errno));
-        #endif
-        return -1;
+    size_t length = strlen(message);
+    size_t total = 0;
+
+    while (total < length) {
+        ssize_t bytes_sent = send(socket, message + total, length - total, MSG_NOSIGNAL);
+        if (bytes_sent == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            #ifndef CHRONOTASK_CTRL
+            LOG_ERROR("Send failed: %s", strerror(errno));
+            #else
+            fprintf(stderr, "Send failed: %s\n", strerror(errno));
+            #endif
+            return -1;
+        }
+        total += bytes_sent;
     }
     #ifndef CHRONOTASK_CTRL
-    LOG_DEBUG("Sent %zd bytes", bytes_sent);
+    LOG_DEBUG("Sent %zu bytes", total);
     #endif
-    return bytes_sent;
+    return total;
 }
 
-int receive_message(int socket, char *buffer, int buffer_size) {
-    ssize_t bytes_received = recv(socket, buffer, buffer_size - 1, 0);
-    if (bytes_received == -1) {
+int frame_append(Buffer *out, const char *payload, size_t len) {
+    return buffer_printf(out, "%zu\n", len) && buffer_append(out, payload, len);
+}
+
+static int frame_complete(const Buffer *pending, size_t *header_len, size_t *payload_len) {
+    size_t length = 0;
+    size_t i = 0;
+
+    for (; i < pending->len && pending->data[i] != '\n'; i++) {
+        if (pending->data[i] < '0' || pending->data[i] > '9' || i >= 10) {
+            return -1;
+        }
+        length = length * 10 + (pending->data[i] - '0');
+    }
+    if (i == pending->len) {
+        return 0;
+    }
+    if (i == 0) {
+        return -1;
+    }
+
+    *header_len = i + 1;
+    *payload_len = length;
+    return pending->len >= *header_len + length;
+}
+
+int receive_frame(int socket, Buffer *pending, Buffer *payload) {
+    char chunk[BUFFER_SIZE];
+    size_t header_len, payload_len;
+    int status;
+
+    while ((status = frame_complete(pending, &header_len, &payload_len)) == 0) {
+        ssize_t bytes_received = recv(socket, chunk, sizeof(chunk), 0);
+        if (bytes_received == 0) {
+            return 0;
+        }
+        if (bytes_received == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            #ifndef CHRONOTASK_CTRL
+            LOG_ERROR("Receive failed: %s", strerror(errno));
+            #else
+            fprintf(stderr, "Receive failed: %s\n", strerror(errno));
+            #endif
+            return -1;
+        }
+        if (!buffer_append(pending, chunk, bytes_received)) {
+            return -1;
+        }
+    }
+    if (status < 0) {
         #ifndef CHRONOTASK_CTRL
-        LOG_ERROR("Receive failed: %s", strerror(errno));
+        LOG_ERROR("Malformed frame header");
         #else
-        fprintf(stderr, "Receive failed: %s\n", strerror(errno));
+        fprintf(stderr, "Malformed frame header\n");
         #endif
         return -1;
     }
-    buffer[bytes_received] = '\0';
-    #ifndef CHRONOTASK_CTRL
-    LOG_DEBUG("Received %zd bytes", bytes_received);
-    #endif
-    return bytes_received;
+
+    payload->len = 0;
+    buffer_append(payload, pending->data + header_len, payload_len);
+    buffer_consume(pending, header_len + payload_len);
+    return 1;
+}
+
+#ifndef CHRONOTASK_CTRL
+int server_init(CommandServer *server, int backlog, int idle_timeout_seconds) {
+    memset(server, 0, sizeof(*server));
+    server->listen_fd = create_socket(backlog > 0 ? backlog : DEFAULT_LISTEN_BACKLOG);
+    if (server->listen_fd == -1) {
+        return 0;
+    }
+
+    int flags = fcntl(server->listen_fd, F_GETFL, 0);
+    fcntl(server->listen_fd, F_SETFL, flags | O_NONBLOCK);
+
+    if (idle_timeout_seconds <= 0) {
+        idle_timeout_seconds = DEFAULT_CLIENT_IDLE_TIMEOUT;
+    }
+    server->idle_timeout = (int64_t)idle_timeout_seconds * NSEC_PER_SEC;
+    return 1;
+}
+
+static void close_client(CommandServer *server, int index) {
+    Client *client = &server->clients[index];
+    LOG_DEBUG("Closing client connection %d", client->fd);
+    close(client->fd);
+    buffer_free(&client->in);
+    buffer_free(&client->out);
+    server->client_count--;
+    if (index != server->client_count) {
+        server->clients[index] = server->clients[server->client_count];
+    }
+    memset(&server->clients[server->client_count], 0, sizeof(Client));
+}
+
+static int client_finished(const Client *client) {
+    return client->close_after_write && client->in.len == 0 && client->out.len == 0;
 }
+
+static int flush_client(Client *client) {
+    while (client->out.len > 0) {
+        ssize_t sent = send(client->fd, client->out.data, client->out.len, MSG_NOSIGNAL);
+        if (sent == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 1;
+            }
+            LOG_ERROR("Send failed: %s", strerror(errno));
+            return 0;
+        }
+        buffer_consume(&client->out, sent);
+        LOG_DEBUG("Sent %zd bytes", sent);
+    }
+    return !client_finished(client);
+}
+
+static int read_client(Client *client) {
+    char chunk[BUFFER_SIZE];
+
+    for (;;) {
+        ssize_t bytes_received = recv(client->fd, chunk, sizeof(chunk), 0);
+        if (bytes_received == 0) {
+            client->close_after_write = 1;
+            if (client->in.len > 0 && client->in.data[client->in.len - 1] != '\n') {
+                buffer_append(&client->in, "\n", 1);
+            }
+            break;
+        }
+        if (bytes_received == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            LOG_ERROR("Receive failed: %s", strerror(errno));
+            return 0;
+        }
+        LOG_DEBUG("Received %zd bytes", bytes_received);
+        if (client->in.len + bytes_received > MAX_PENDING_INPUT) {
+            LOG_WARNING("Dropping client %d: more than %d bytes of unprocessed commands",
+                        client->fd, MAX_PENDING_INPUT);
+            return 0;
+        }
+        buffer_append(&client->in, chunk, bytes_received);
+    }
+
+    return !client_finished(client);
+}
+
+int server_fill_pollfds(CommandServer *server, struct pollfd *fds, int max_fds) {
+    int count = 0;
+    if (count < max_fds) {
+        fds[count].fd = server->listen_fd;
+        fds[count].events = server->client_count < MAX_CLIENTS ? POLLIN : 0;
+        fds[count].revents = 0;
+        count++;
+    }
+    for (int i = 0; i < server->client_count && count < max_fds; i++) {
+        Client *client = &server->clients[i];
+        int wants_input = !client->close_after_write && client->out.len < OUTPUT_HIGH_WATER;
+        fds[count].fd = client->fd;
+        fds[count].events = (wants_input ? POLLIN : 0) | (client->out.len > 0 ? POLLOUT : 0);
+        fds[count].revents = 0;
+        count++;
+    }
+    return count;
+}
+
+void server_handle_events(CommandServer *server, const struct pollfd *fds, int nfds) {
+    int64_t now = now_ns();
+
+    for (int i = server->client_count - 1; i >= 0; i--) {
+        Client *client = &server->clients[i];
+        int alive = 1;
+
+        if (i + 1 < nfds && fds[i + 1].fd == client->fd && fds[i + 1].revents) {
+            short revents = fds[i + 1].revents;
+            client->last_activity = now;
+            if (revents & (POLLIN | POLLHUP)) {
+                alive = read_client(client);
+            }
+            if (alive && (revents & POLLERR)) {
+                alive = 0;
+            }
+            if (alive && (revents & POLLOUT)) {
+                alive = flush_client(client);
+            }
+        } else if (client->subscription == SUBSCRIBE_NONE &&
+                   now - client->last_activity > server->idle_timeout) {
+            LOG_DEBUG("Client %d idle for too long", client->fd);
+            alive = 0;
+        }
+
+        if (!alive) {
+            close_client(server, i);
+        }
+    }
+
+    if (nfds > 0 && (fds[0].revents & POLLIN)) {
+        while (server->client_count < MAX_CLIENTS) {
+            int client_socket = accept_connection(server->listen_fd);
+            if (client_socket == -1) {
+                break;
+            }
+            Client *client = &server->clients[server->client_count++];
+            memset(client, 0, sizeof(*client));
+            client->fd = client_socket;
+            client->last_activity = now;
+        }
+    }
+}
+
+void server_process_commands(CommandServer *server, CommandHandler handler) {
+    Buffer response = {0};
+
+    for (int i = server->client_count - 1; i >= 0; i--) {
+        Client *client = &server->clients[i];
+        size_t consumed = 0;
+        char *newline;
+
+        while ((newline = memchr(client->in.data + consumed, '\n', client->in.len - consumed)) != NULL) {
+            char *line = client->in.data + consumed;
+            size_t line_len = newline - line;
+            consumed += line_len + 1;
+
+            *newline = '\0';
+            if (line_len > 0 && line[line_len - 1] == '\r') {
+                line[--line_len] = '\0';
+            }
+            if (line_len == 0) {
+                continue;
+            }
+
+            response.len = 0;
+            if (line_len >= BUFFER_SIZE) {
+                buffer_printf(&response, "Command too long");
+            } else {
+                Subscription subscription = handler(line, &response);
+                if (subscription != SUBSCRIBE_NONE) {
+                    client->subscription = subscription;
+                    LOG_DEBUG("Client %d subscribed to status %s", client->fd,
+                              subscription == SUBSCRIBE_TICKS ? "ticks" : "changes");
+                }
+            }
+            frame_append(&client->out, response.data ? response.data : "", response.len);
+        }
+
+        if (consumed > 0) {
+            buffer_consume(&client->in, consumed);
+        }
+        if (!flush_client(client)) {
+            close_client(server, i);
+        }
+    }
+
+    buffer_free(&response);
+}
+
+void server_broadcast(CommandServer *server, Subscription level, const char *record, size_t len) {
+    for (int i = server->client_count - 1; i >= 0; i--) {
+        Client *client = &server->clients[i];
+        if (client->subscription < level) {
+            continue;
+        }
+        if (client->out.len + len > SUBSCRIBER_BUFFER_LIMIT) {
+            server->dropped_subscribers++;
+            LOG_WARNING("Subscriber %d stopped reading status records, closing it", client->fd);
+            close_client(server, i);
+            continue;
+        }
+        frame_append(&client->out, record, len);
+        if (!flush_client(client)) {
+            close_client(server, i);
+        }
+    }
+}
+
+int server_poll_timeout(const CommandServer *server) {
+    int64_t now = now_ns();
+    int64_t earliest = INT64_MAX;
+    for (int i = 0; i < server->client_count; i++) {
+        if (server->clients[i].subscription != SUBSCRIBE_NONE) {
+            continue;
+        }
+        int64_t expiry = server->clients[i].last_activity + server->idle_timeout;
+        if (expiry < earliest) {
+            earliest = expiry;
+        }
+    }
+
+    if (earliest == INT64_MAX) {
+        return -1;
+    }
+    if (earliest <= now) {
+        return 0;
+    }
+    return (int)((earliest - now + 999999) / 1000000) + 1;
+}
+
+void server_close(CommandServer *server) {
+    for (int i = server->client_count - 1; i >= 0; i--) {
+        flush_client(&server->clients[i]);
+        close_client(server, i);
+    }
+    if (server->listen_fd != -1) {
+        close(server->listen_fd);
+        server->listen_fd = -1;
+    }
+    unlink(SOCKET_PATH);
+}
+#endif
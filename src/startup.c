@@ -0,0 +1,243 @@
+#include "startup.h"
+#include "timekeeper.h"
+#include "error_report.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define STARTUP_MAX_SPANS 128
+#define STARTUP_MAX_THREADS 16
+
+typedef struct {
+    const char *name;
+    const char *thread;
+    int64_t start;
+    int64_t end;
+    int depth;
+} StartupSpan;
+
+static pthread_mutex_t startup_lock = PTHREAD_MUTEX_INITIALIZER;
+static StartupSpan spans[STARTUP_MAX_SPANS];
+static int span_count = 0;
+static int pending_tasks = 0;
+static int timeline_logged = 0;
+static char *trace_file = NULL;
+static _Thread_local const char *thread_name = NULL;
+
+static int64_t exec_time = 0;
+static int64_t stage_start = 0;
+static int64_t waited = 0;
+static int finished = 0;
+
+int64_t startup_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static double to_ms(int64_t ns) {
+    return ns / 1e6;
+}
+
+static int64_t read_exec_time(int64_t now) {
+    char buffer[1024];
+    FILE *file = fopen("/proc/self/stat", "r");
+    if (!file) {
+        return now;
+    }
+    size_t len = fread(buffer, 1, sizeof(buffer) - 1, file);
+    fclose(file);
+    buffer[len] = '\0';
+
+    char *fields = strrchr(buffer, ')');
+    unsigned long long start_ticks;
+    long ticks_per_sec = sysconf(_SC_CLK_TCK);
+    if (!fields || ticks_per_sec <= 0 ||
+        sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu",
+               &start_ticks) != 1) {
+        return now;
+    }
+
+    int64_t start = (int64_t)start_ticks * (NSEC_PER_SEC / ticks_per_sec);
+    return start < now ? start : now;
+}
+
+static int compare_spans(const void *a, const void *b) {
+    const StartupSpan *left = a;
+    const StartupSpan *right = b;
+    if (left->start != right->start) {
+        return (left->start > right->start) - (left->start < right->start);
+    }
+    return (left->end < right->end) - (left->end > right->end);
+}
+
+static void nest_spans(void) {
+    qsort(spans, span_count, sizeof(StartupSpan), compare_spans);
+    for (int i = 0; i < span_count; i++) {
+        spans[i].depth = 0;
+        for (int j = 0; j < i; j++) {
+            if (strcmp(spans[j].thread, spans[i].thread) == 0 && spans[j].end >= spans[i].end) {
+                spans[i].depth++;
+            }
+        }
+    }
+}
+
+static void log_timeline(void) {
+    LOG_INFO("Startup timeline (ms after exec):");
+    LOG_INFO("  %8s %8s  %-8s %s", "start", "duration", "thread", "phase");
+    for (int i = 0; i < span_count; i++) {
+        LOG_INFO("  %8.1f %8.1f  %-8s %*s%s", to_ms(spans[i].start - exec_time),
+                 to_ms(spans[i].end - spans[i].start), spans[i].thread,
+                 spans[i].depth * 2, "", spans[i].name);
+    }
+}
+
+static int thread_id(const char **threads, int *count, const char *name) {
+    for (int i = 0; i < *count; i++) {
+        if (strcmp(threads[i], name) == 0) {
+            return i + 1;
+        }
+    }
+    if (*count < STARTUP_MAX_THREADS) {
+        threads[(*count)++] = name;
+        return *count;
+    }
+    return STARTUP_MAX_THREADS;
+}
+
+static void write_trace(const char *path) {
+    const char *threads[STARTUP_MAX_THREADS];
+    int thread_count = 0;
+    int pid = (int)getpid();
+    char temp_path[4096];
+
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    FILE *file = fopen(temp_path, "w");
+    if (!file) {
+        LOG_WARNING("Failed to write startup trace %s", path);
+        return;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"chronotask\"}}",
+            pid);
+    for (int i = 0; i < span_count; i++) {
+        int known = thread_count;
+        int tid = thread_id(threads, &thread_count, spans[i].thread);
+        if (thread_count > known) {
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    pid, tid, spans[i].thread);
+        }
+        fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"startup\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                      "\"ts\":%.3f,\"dur\":%.3f}",
+                spans[i].name, pid, tid, (spans[i].start - exec_time) / 1e3,
+                (spans[i].end - spans[i].start) / 1e3);
+    }
+    fprintf(file, "\n]}\n");
+
+    if (fclose(file) != 0 || rename(temp_path, path) == -1) {
+        LOG_WARNING("Failed to write startup trace %s", path);
+        unlink(temp_path);
+        return;
+    }
+    LOG_INFO("Wrote startup trace with %d phases to %s", span_count, path);
+}
+
+static void record_span(const char *name, int64_t start, int64_t end) {
+    int recorded = 0;
+
+    pthread_mutex_lock(&startup_lock);
+    if (thread_name && !timeline_logged && span_count < STARTUP_MAX_SPANS) {
+        spans[span_count++] = (StartupSpan){ name, thread_name, start, end, 0 };
+        recorded = 1;
+    }
+    pthread_mutex_unlock(&startup_lock);
+
+    if (recorded) {
+        LOG_DEBUG("Startup: %s took %.2f ms on the %s thread", name, to_ms(end - start), thread_name);
+    }
+}
+
+static void finish_timeline(void) {
+    pthread_mutex_lock(&startup_lock);
+    if (finished && pending_tasks == 0 && !timeline_logged) {
+        timeline_logged = 1;
+        nest_spans();
+        log_timeline();
+        if (trace_file) {
+            write_trace(trace_file);
+        }
+    }
+    pthread_mutex_unlock(&startup_lock);
+}
+
+void startup_begin(void) {
+    thread_name = "main";
+    stage_start = startup_now();
+    exec_time = read_exec_time(stage_start);
+    record_span("process start", exec_time, stage_start);
+}
+
+void startup_set_trace_file(const char *path) {
+    free(trace_file);
+    trace_file = strdup(path);
+}
+
+void startup_set_thread(const char *name) {
+    thread_name = name;
+}
+
+void startup_phase(const char *name, int64_t start) {
+    record_span(name, start, startup_now());
+}
+
+void startup_stage(const char *name) {
+    int64_t now = startup_now();
+    record_span(name, stage_start, now);
+    stage_start = now;
+}
+
+void startup_wait(const char *name) {
+    int64_t now = startup_now();
+    record_span(name, stage_start, now);
+    waited += now - stage_start;
+    stage_start = now;
+}
+
+void startup_task_begin(void) {
+    pthread_mutex_lock(&startup_lock);
+    pending_tasks++;
+    pthread_mutex_unlock(&startup_lock);
+}
+
+void startup_task_end(const char *name, int64_t start) {
+    startup_phase(name, start);
+
+    pthread_mutex_lock(&startup_lock);
+    pending_tasks--;
+    pthread_mutex_unlock(&startup_lock);
+    finish_timeline();
+}
+
+void startup_first_frame(void) {
+    if (finished) {
+        return;
+    }
+
+    int64_t now = startup_now();
+    record_span("first frame", stage_start, now);
+    if (waited > 0) {
+        LOG_INFO("First overlay frame %.1f ms after exec (%.1f ms more waiting for input)",
+                 to_ms(now - exec_time - waited), to_ms(waited));
+    } else {
+        LOG_INFO("First overlay frame %.1f ms after exec", to_ms(now - exec_time));
+    }
+
+    pthread_mutex_lock(&startup_lock);
+    finished = 1;
+    pthread_mutex_unlock(&startup_lock);
+    finish_timeline();
+}
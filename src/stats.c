@@ -0,0 +1,207 @@
+#include "stats.h"
+#include "timekeeper.h"
+#include "overlay.h"
+#include "error_report.h"
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+
+RuntimeStats runtime_stats;
+
+static const char *command_names[COMMAND_TYPE_COUNT] = {
+    "pause", "resume", "next", "previous", "extend", "status",
+    "subscribe", "config", "stats", "abort", "other"
+};
+
+void histogram_record(Histogram *histogram, int64_t ns) {
+    int bucket = ns > 0 ? 64 - __builtin_clzll((unsigned long long)ns) : 0;
+    if (bucket >= HISTOGRAM_BUCKETS) {
+        bucket = HISTOGRAM_BUCKETS - 1;
+    }
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->total_ns += ns;
+    if (ns > histogram->max_ns) {
+        histogram->max_ns = ns;
+    }
+}
+
+int64_t histogram_percentile(const Histogram *histogram, double fraction) {
+    unsigned long target = (unsigned long)(histogram->count * fraction);
+    unsigned long seen = 0;
+
+    if (histogram->count == 0) {
+        return 0;
+    }
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen > target) {
+            int64_t upper = i > 0 ? ((int64_t)1 << i) - 1 : 0;
+            return upper < histogram->max_ns ? upper : histogram->max_ns;
+        }
+    }
+    return histogram->max_ns;
+}
+
+void stats_loop_start(void) {
+    runtime_stats.loop_start = now_ns();
+}
+
+void stats_loop_iteration(void) {
+    runtime_stats.loop_iterations++;
+}
+
+void stats_wakeup(void) {
+    runtime_stats.wakeups++;
+}
+
+void stats_frame(int64_t render_ns) {
+    histogram_record(&runtime_stats.frame_time, render_ns);
+}
+
+void stats_command(const char *cmd, int64_t latency_ns) {
+    size_t len = strcspn(cmd, " ");
+    int type = 0;
+
+    while (type < COMMAND_OTHER &&
+           (strlen(command_names[type]) != len || strncmp(cmd, command_names[type], len) != 0)) {
+        type++;
+    }
+    histogram_record(&runtime_stats.commands[type], latency_ns);
+}
+
+const char *stats_command_name(CommandType type) {
+    return command_names[type];
+}
+
+long stats_rss_bytes(void) {
+    long pages = 0;
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (!file) {
+        return -1;
+    }
+    if (fscanf(file, "%*s %ld", &pages) != 1) {
+        pages = -1;
+    }
+    fclose(file);
+    return pages < 0 ? -1 : pages * sysconf(_SC_PAGESIZE);
+}
+
+int stats_open_fds(void) {
+    DIR *dir = opendir("/proc/self/fd");
+    struct dirent *entry;
+    int count = 0;
+
+    if (!dir) {
+        return -1;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            count++;
+        }
+    }
+    closedir(dir);
+    return count - 1;
+}
+
+static double uptime_seconds(void) {
+    return runtime_stats.loop_start ? (now_ns() - runtime_stats.loop_start) / (double)NSEC_PER_SEC : 0.0;
+}
+
+static double per_second(unsigned long count, double seconds) {
+    return seconds > 0.0 ? count / seconds : 0.0;
+}
+
+static double average_us(const Histogram *histogram) {
+    return histogram->count ? histogram->total_ns / 1000.0 / histogram->count : 0.0;
+}
+
+static void format_histogram_text(Buffer *out, const Histogram *histogram) {
+    buffer_printf(out, "avg %.1f us, p50 %.1f us, p99 %.1f us, max %.1f us",
+                  average_us(histogram),
+                  histogram_percentile(histogram, 0.50) / 1000.0,
+                  histogram_percentile(histogram, 0.99) / 1000.0,
+                  histogram->max_ns / 1000.0);
+}
+
+void stats_format_text(Buffer *out) {
+    const RuntimeStats *stats = &runtime_stats;
+    double uptime = uptime_seconds();
+    OverlayStats overlay;
+    LogStats log;
+
+    get_overlay_stats(&overlay);
+    get_log_stats(&log);
+
+    buffer_printf(out, "Uptime: %.0f s\n", uptime);
+    buffer_printf(out, "Main loop: %lu iterations (%.1f/s), %lu wakeups (%.1f/s)\n",
+                  stats->loop_iterations, per_second(stats->loop_iterations, uptime),
+                  stats->wakeups, per_second(stats->wakeups, uptime));
+    buffer_printf(out, "Overlay: %lu frames, %.1f X requests/frame, %lu round-trips, text cache %lu/%lu hits\n",
+                  overlay.frames,
+                  overlay.frames ? (double)overlay.requests / overlay.frames : 0.0,
+                  overlay.round_trips, overlay.cache_hits, overlay.cache_hits + overlay.cache_misses);
+    buffer_printf(out, "Frame render: ");
+    format_histogram_text(out, &stats->frame_time);
+    buffer_printf(out, "\nCommands:");
+    for (int i = 0; i < COMMAND_TYPE_COUNT; i++) {
+        const Histogram *histogram = &stats->commands[i];
+        if (histogram->count == 0) {
+            continue;
+        }
+        buffer_printf(out, "\n  %-10s %6lu  ", command_names[i], histogram->count);
+        format_histogram_text(out, histogram);
+    }
+    buffer_printf(out, "\nLog: %lu lines written, %lu dropped\n", log.written, log.dropped);
+    buffer_printf(out, "Process: %.1f MB RSS, %d open fds",
+                  stats_rss_bytes() / (1024.0 * 1024.0), stats_open_fds());
+}
+
+static void format_histogram_json(Buffer *out, const Histogram *histogram) {
+    int last = HISTOGRAM_BUCKETS - 1;
+    while (last >= 0 && histogram->buckets[last] == 0) {
+        last--;
+    }
+
+    buffer_printf(out, "{\"count\":%lu,\"sum_ns\":%lld,\"max_ns\":%lld,\"p50_ns\":%lld,\"p99_ns\":%lld,\"buckets\":[",
+                  histogram->count, (long long)histogram->total_ns, (long long)histogram->max_ns,
+                  (long long)histogram_percentile(histogram, 0.50),
+                  (long long)histogram_percentile(histogram, 0.99));
+    for (int i = 0; i <= last; i++) {
+        buffer_printf(out, "%s%lu", i > 0 ? "," : "", histogram->buckets[i]);
+    }
+    buffer_printf(out, "]}");
+}
+
+void stats_format_json(Buffer *out) {
+    const RuntimeStats *stats = &runtime_stats;
+    double uptime = uptime_seconds();
+    OverlayStats overlay;
+    LogStats log;
+    int first = 1;
+
+    get_overlay_stats(&overlay);
+    get_log_stats(&log);
+
+    buffer_printf(out, "{\"uptime_seconds\":%.3f,", uptime);
+    buffer_printf(out, "\"loop\":{\"iterations\":%lu,\"wakeups\":%lu,\"wakeups_per_second\":%.3f},",
+                  stats->loop_iterations, stats->wakeups, per_second(stats->wakeups, uptime));
+    buffer_printf(out, "\"overlay\":{\"frames\":%lu,\"x_requests\":%lu,\"round_trips\":%lu,"
+                  "\"cache_hits\":%lu,\"cache_misses\":%lu,\"render_ns\":",
+                  overlay.frames, overlay.requests, overlay.round_trips,
+                  overlay.cache_hits, overlay.cache_misses);
+    format_histogram_json(out, &stats->frame_time);
+    buffer_printf(out, "},\"commands\":{");
+    for (int i = 0; i < COMMAND_TYPE_COUNT; i++) {
+        if (stats->commands[i].count == 0) {
+            continue;
+        }
+        buffer_printf(out, "%s\"%s\":", first ? "" : ",", command_names[i]);
+        format_histogram_json(out, &stats->commands[i]);
+        first = 0;
+    }
+    buffer_printf(out, "},\"log\":{\"written\":%lu,\"dropped\":%lu},", log.written, log.dropped);
+    buffer_printf(out, "\"process\":{\"rss_bytes\":%ld,\"open_fds\":%d}}",
+                  stats_rss_bytes(), stats_open_fds());
+}
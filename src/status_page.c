@@ -0,0 +1,158 @@
+#include "status_page.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifndef CHRONOTASK_CTRL
+#include "error_report.h"
+#endif
+
+static StatusPage *page = NULL;
+static char page_path[PATH_MAX] = "";
+
+const char *status_page_path(void) {
+    if (page_path[0] == '\0') {
+        const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+        if (runtime_dir && runtime_dir[0] == '/') {
+            snprintf(page_path, sizeof(page_path), "%s/%s", runtime_dir, STATUS_PAGE_NAME);
+        } else {
+            snprintf(page_path, sizeof(page_path), "/dev/shm/%s-%u", STATUS_PAGE_NAME, (unsigned)getuid());
+        }
+    }
+    return page_path;
+}
+
+static int owned_by_us(int fd) {
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_uid == getuid();
+}
+
+int status_page_create(void) {
+    const char *path = status_page_path();
+    int fd = open(path, O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        #ifndef CHRONOTASK_CTRL
+        LOG_WARNING("Failed to create status page %s: %s", path, strerror(errno));
+        #endif
+        return 0;
+    }
+    if (!owned_by_us(fd) || fchmod(fd, 0600) == -1) {
+        #ifndef CHRONOTASK_CTRL
+        LOG_WARNING("Status page %s is not a regular file owned by us, not using it", path);
+        #endif
+        close(fd);
+        return 0;
+    }
+
+    if (ftruncate(fd, sizeof(StatusPage)) == -1) {
+        #ifndef CHRONOTASK_CTRL
+        LOG_WARNING("Failed to size status page: %s", strerror(errno));
+        #endif
+        close(fd);
+        return 0;
+    }
+
+    void *mapping = mmap(NULL, sizeof(StatusPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        #ifndef CHRONOTASK_CTRL
+        LOG_WARNING("Failed to map status page: %s", strerror(errno));
+        #endif
+        return 0;
+    }
+
+    page = mapping;
+    memset(page, 0, sizeof(*page));
+    page->version = STATUS_PAGE_VERSION;
+    __atomic_store_n(&page->magic, STATUS_PAGE_MAGIC, __ATOMIC_RELEASE);
+    #ifndef CHRONOTASK_CTRL
+    LOG_INFO("Publishing status page at %s", path);
+    #endif
+    return 1;
+}
+
+void status_page_publish(const StatusPage *state) {
+    if (!page) {
+        return;
+    }
+
+    uint32_t sequence = __atomic_load_n(&page->sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&page->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    page->clock_id = state->clock_id;
+    page->deadline = state->deadline;
+    page->remaining = state->remaining;
+    page->paused = state->paused;
+    page->task_index = state->task_index;
+    page->task_count = state->task_count;
+    page->loops_remaining = state->loops_remaining;
+    memcpy(page->routine_name, state->routine_name, sizeof(page->routine_name));
+    memcpy(page->task_name, state->task_name, sizeof(page->task_name));
+
+    __atomic_store_n(&page->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+void status_page_destroy(void) {
+    if (!page) {
+        return;
+    }
+    munmap(page, sizeof(StatusPage));
+    page = NULL;
+    unlink(status_page_path());
+}
+
+const StatusPage *status_page_map(void) {
+    int fd = open(status_page_path(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd == -1) {
+        return NULL;
+    }
+    if (!owned_by_us(fd)) {
+        close(fd);
+        return NULL;
+    }
+
+    void *mapping = mmap(NULL, sizeof(StatusPage), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+    return mapping;
+}
+
+int status_page_read(const StatusPage *shared, StatusPage *snapshot) {
+    if (__atomic_load_n(&shared->magic, __ATOMIC_ACQUIRE) != STATUS_PAGE_MAGIC ||
+        shared->version != STATUS_PAGE_VERSION) {
+        return 0;
+    }
+
+    for (int attempt = 0; attempt < 1000; attempt++) {
+        uint32_t before = __atomic_load_n(&shared->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            continue;
+        }
+        memcpy(snapshot, shared, sizeof(*snapshot));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shared->sequence, __ATOMIC_RELAXED) == before) {
+            return before != 0;
+        }
+    }
+    return 0;
+}
+
+int64_t status_page_remaining(const StatusPage *snapshot) {
+    if (snapshot->paused) {
+        return snapshot->remaining;
+    }
+
+    struct timespec ts;
+    clock_gettime(snapshot->clock_id, &ts);
+    return snapshot->deadline - ((int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec);
+}
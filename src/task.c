@@ -1,6 +1,11 @@
 #include "task.h"
 #include "error_report.h"
 #include "config.h"
+#include "timekeeper.h"
+#include "status_page.h"
+#include "routine_cache.h"
+#include "startup.h"
+#include "thread.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,11 +13,62 @@
 #include <ctype.h>
 #include <dirent.h>
 #include <time.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define LIBRARY_MAX_WORKERS 8
+
+typedef struct {
+    char **paths;
+    RoutineList *lists;
+    int *loaded;
+    int count;
+    atomic_int next;
+} LibraryLoad;
 
 RoutineList routine_list = {0};
 int current_routine = -1;
 static int current_task = 0;
-static time_t task_start_time;
+static int loops_remaining = 0;
+static Countdown task_countdown;
+static pthread_t cache_thread;
+static int cache_thread_running = 0;
+static char routines_path[PATH_MAX];
+static int warning_pending = 0;
+
+static void publish_task_state(void) {
+    Routine* current_routine_ptr = &routine_list.routines[current_routine];
+    StatusPage state;
+
+    memset(&state, 0, sizeof(state));
+    state.clock_id = get_timekeeping_clock();
+    state.deadline = task_countdown.deadline;
+    state.remaining = countdown_remaining(&task_countdown);
+    state.paused = task_countdown.paused;
+    state.task_index = current_task;
+    state.task_count = current_routine_ptr->task_count;
+    state.loops_remaining = current_routine_ptr->inf_loop ? -1 : loops_remaining;
+    strncpy(state.routine_name, current_routine_ptr->name, sizeof(state.routine_name) - 1);
+    strncpy(state.task_name, get_current_task_name(), sizeof(state.task_name) - 1);
+    status_page_publish(&state);
+}
+
+static void start_current_task(int64_t start) {
+    int was_paused = task_countdown.paused;
+    countdown_start_at(&task_countdown, start, (int64_t)get_current_task_duration() * NSEC_PER_SEC);
+    warning_pending = routine_list.routines[current_routine].warn_before > 0 &&
+                      get_current_task_duration() > routine_list.routines[current_routine].warn_before;
+    if (was_paused) {
+        countdown_pause(&task_countdown);
+    }
+    publish_task_state();
+}
 
 
 int parse_duration(const char* duration_str) {
@@ -46,38 +102,151 @@ int parse_duration(const char* duration_str) {
     return total_seconds;
 }
 
-int read_routines_from_file(const char* filename) {
-    FILE *file = fopen(filename, "r");
-    yaml_parser_t parser;
-    yaml_event_t event;
+typedef struct {
+    uint32_t *names;
+    int32_t *durations;
+    uint32_t *sounds;
+    int count;
+    int capacity;
+} TaskBuffer;
 
-    if (!file) {
-        LOG_ERROR("Failed to open file %s", filename);
+static void task_buffer_free(TaskBuffer *tasks) {
+    free(tasks->names);
+    free(tasks->durations);
+    free(tasks->sounds);
+}
+
+static int task_buffer_push(TaskBuffer *tasks, uint32_t name, int32_t duration, uint32_t sound) {
+    if (tasks->count == tasks->capacity) {
+        int capacity = tasks->capacity ? tasks->capacity * 2 : 16;
+        uint32_t *names = realloc(tasks->names, capacity * sizeof(uint32_t));
+        if (!names) {
+            return 0;
+        }
+        tasks->names = names;
+        int32_t *durations = realloc(tasks->durations, capacity * sizeof(int32_t));
+        if (!durations) {
+            return 0;
+        }
+        tasks->durations = durations;
+        uint32_t *sounds = realloc(tasks->sounds, capacity * sizeof(uint32_t));
+        if (!sounds) {
+            return 0;
+        }
+        tasks->sounds = sounds;
+        tasks->capacity = capacity;
+    }
+
+    tasks->names[tasks->count] = name;
+    tasks->durations[tasks->count] = duration;
+    tasks->sounds[tasks->count] = sound;
+    tasks->count++;
+    return 1;
+}
+
+static void reset_record(RoutineRecord *record, uint32_t empty) {
+    memset(record, 0, sizeof(*record));
+    record->name = empty;
+    record->sound = empty;
+    record->complete_sound = empty;
+    record->warning_sound = empty;
+}
+
+static int append_routine(RoutineList *list, RoutineRecord *record, const TaskBuffer *tasks) {
+    record->task_count = tasks->count;
+    record->task_names = arena_push(&list->arena, tasks->names, tasks->count * sizeof(uint32_t), sizeof(uint32_t));
+    record->durations = arena_push(&list->arena, tasks->durations, tasks->count * sizeof(int32_t), sizeof(int32_t));
+    record->task_sounds = arena_push(&list->arena, tasks->sounds, tasks->count * sizeof(uint32_t), sizeof(uint32_t));
+    if (record->task_names == ARENA_INVALID || record->durations == ARENA_INVALID ||
+        record->task_sounds == ARENA_INVALID) {
         return 0;
     }
 
-    LOG_INFO("Reading routines from file: %s", filename);
+    if (list->routine_count == list->routine_capacity) {
+        int capacity = list->routine_capacity ? list->routine_capacity * 2 : 16;
+        RoutineRecord *records = realloc(list->records, capacity * sizeof(RoutineRecord));
+        if (!records) {
+            return 0;
+        }
+        list->records = records;
+        list->routine_capacity = capacity;
+    }
+    list->records[list->routine_count++] = *record;
+    return 1;
+}
 
-    if (!yaml_parser_initialize(&parser)) {
-        LOG_ERROR("Failed to initialize YAML parser");
-        fclose(file);
+int finalize_routines(RoutineList *list) {
+    free(list->routines);
+    list->routines = calloc(list->routine_count ? list->routine_count : 1, sizeof(Routine));
+    if (!list->routines) {
         return 0;
     }
 
-    yaml_parser_set_input_file(&parser, file);
+    const char *base = list->arena.data;
+    for (int i = 0; i < list->routine_count; i++) {
+        const RoutineRecord *record = &list->records[i];
+        Routine *routine = &list->routines[i];
+        routine->name = base + record->name;
+        routine->strings = base;
+        routine->task_names = (const uint32_t*)(base + record->task_names);
+        routine->durations = (const int32_t*)(base + record->durations);
+        routine->task_sounds = (const uint32_t*)(base + record->task_sounds);
+        routine->task_count = record->task_count;
+        routine->loop = record->loop;
+        routine->inf_loop = record->inf_loop;
+        routine->sound = base + record->sound;
+        routine->complete_sound = base + record->complete_sound;
+        routine->warning_sound = base + record->warning_sound;
+        routine->warn_before = record->warn_before;
+    }
+    return 1;
+}
+
+void free_routines(RoutineList *list) {
+    if (list->mapping) {
+        munmap(list->mapping, list->mapping_size);
+    } else {
+        arena_free(&list->arena);
+        free(list->records);
+    }
+    if (list->index) {
+        free(list->index->source_path);
+        free(list->index->spans);
+        free(list->index);
+    }
+    free(list->routines);
+    memset(list, 0, sizeof(*list));
+}
+
+const char* get_routine_task_name(const Routine *routine, int index) {
+    return routine->strings + routine->task_names[index];
+}
+
+const char* get_routine_task_sound(const Routine *routine, int index) {
+    const char *sound = routine->strings + routine->task_sounds[index];
+    return sound[0] != '\0' ? sound : routine->sound;
+}
 
+static int parse_routines(yaml_parser_t *parser, RoutineList *list) {
+    yaml_event_t event;
     int in_routine = 0;
     int in_tasks = 0;
     int in_task = 0;
+    int ok = 1;
     char current_key[256] = "";
-    Routine current_routine = {0};
-    Task current_task = {0};
+    uint32_t empty_name = arena_intern(&list->arena, "");
+    RoutineRecord current_routine;
+    uint32_t task_name = empty_name;
+    int32_t task_duration = 0;
+    uint32_t task_sound = empty_name;
+    TaskBuffer tasks = {0};
+
+    reset_record(&current_routine, empty_name);
 
     do {
-        if (!yaml_parser_parse(&parser, &event)) {
-            fprintf(stderr, "Parser error %d\n", parser.error);
-            yaml_parser_delete(&parser);
-            fclose(file);
+        if (!yaml_parser_parse(parser, &event)) {
+            LOG_ERROR("Parser error %d", parser->error);
+            task_buffer_free(&tasks);
             return 0;
         }
 
@@ -89,29 +258,52 @@ int read_routines_from_file(const char* filename) {
                 } else if (strcmp((char*)event.data.scalar.value, "tasks") == 0) {
                     in_tasks = 1;
                 } else if (in_routine && !in_tasks) {
-                    if (strcmp((char*)event.data.scalar.value, "loop") == 0) {
-                        strncpy(current_key, "loop", 255);
-                    } else if (strcmp((char*)event.data.scalar.value, "inf-loop") == 0) {
-                        strncpy(current_key, "inf-loop", 255);
+                    if (current_key[0] == '\0' &&
+                        (strcmp((char*)event.data.scalar.value, "loop") == 0 ||
+                         strcmp((char*)event.data.scalar.value, "inf-loop") == 0 ||
+                         strcmp((char*)event.data.scalar.value, "sound") == 0 ||
+                         strcmp((char*)event.data.scalar.value, "complete-sound") == 0 ||
+                         strcmp((char*)event.data.scalar.value, "warning-sound") == 0 ||
+                         strcmp((char*)event.data.scalar.value, "warn-before") == 0)) {
+                        strncpy(current_key, (char*)event.data.scalar.value, 255);
                     } else if (current_key[0] != '\0') {
+                        const char *value = (char*)event.data.scalar.value;
                         if (strcmp(current_key, "routine-name") == 0) {
-                            strncpy(current_routine.name, (char*)event.data.scalar.value, MAX_TASK_NAME - 1);
+                            current_routine.name = arena_intern(&list->arena, value);
+                            ok = current_routine.name != ARENA_INVALID;
                         } else if (strcmp(current_key, "loop") == 0) {
-                            current_routine.loop = atoi((char*)event.data.scalar.value);
+                            current_routine.loop = atoi(value);
                         } else if (strcmp(current_key, "inf-loop") == 0) {
-                            current_routine.inf_loop = (strcmp((char*)event.data.scalar.value, "true") == 0);
+                            current_routine.inf_loop = (strcmp(value, "true") == 0);
+                        } else if (strcmp(current_key, "sound") == 0) {
+                            current_routine.sound = arena_intern(&list->arena, value);
+                            ok = current_routine.sound != ARENA_INVALID;
+                        } else if (strcmp(current_key, "complete-sound") == 0) {
+                            current_routine.complete_sound = arena_intern(&list->arena, value);
+                            ok = current_routine.complete_sound != ARENA_INVALID;
+                        } else if (strcmp(current_key, "warning-sound") == 0) {
+                            current_routine.warning_sound = arena_intern(&list->arena, value);
+                            ok = current_routine.warning_sound != ARENA_INVALID;
+                        } else if (strcmp(current_key, "warn-before") == 0) {
+                            current_routine.warn_before = parse_duration(value);
                         }
                         current_key[0] = '\0';
                     }
                 } else if (in_tasks) {
-                    if (strcmp((char*)event.data.scalar.value, "name") == 0 ||
-                        strcmp((char*)event.data.scalar.value, "duration") == 0) {
+                    if (current_key[0] == '\0' &&
+                        (strcmp((char*)event.data.scalar.value, "name") == 0 ||
+                         strcmp((char*)event.data.scalar.value, "duration") == 0 ||
+                         strcmp((char*)event.data.scalar.value, "sound") == 0)) {
                         strncpy(current_key, (char*)event.data.scalar.value, 255);
                     } else if (current_key[0] != '\0') {
                         if (strcmp(current_key, "name") == 0) {
-                            strncpy(current_task.name, (char*)event.data.scalar.value, MAX_TASK_NAME - 1);
+                            task_name = arena_intern(&list->arena, (char*)event.data.scalar.value);
+                            ok = task_name != ARENA_INVALID;
                         } else if (strcmp(current_key, "duration") == 0) {
-                            current_task.duration = parse_duration((char*)event.data.scalar.value);
+                            task_duration = parse_duration((char*)event.data.scalar.value);
+                        } else if (strcmp(current_key, "sound") == 0) {
+                            task_sound = arena_intern(&list->arena, (char*)event.data.scalar.value);
+                            ok = task_sound != ARENA_INVALID;
                         }
                         current_key[0] = '\0';
                     }
@@ -120,31 +312,34 @@ int read_routines_from_file(const char* filename) {
             case YAML_MAPPING_START_EVENT:
                 if (in_tasks) {
                     in_task = 1;
-                    memset(&current_task, 0, sizeof(Task));
+                    task_name = empty_name;
+                    task_duration = 0;
+                    task_sound = empty_name;
                 }
                 break;
             case YAML_MAPPING_END_EVENT:
                 if (in_task) {
-                    if (current_routine.task_count < MAX_TASKS) {
-                        current_routine.tasks[current_routine.task_count++] = current_task;
-                        printf("Added task: %s, duration: %d seconds\n",
-                               current_task.name, current_task.duration);
+                    if (task_duration <= 0) {
+                        LOG_WARNING("Task %s has no duration, skipping it", list->arena.data + task_name);
                     } else {
-                        fprintf(stderr, "Maximum number of tasks reached for routine %s\n", current_routine.name);
+                        ok = task_buffer_push(&tasks, task_name, task_duration, task_sound);
+                        LOG_DEBUG("Added task: %s, duration: %d seconds",
+                                  list->arena.data + task_name, task_duration);
                     }
                     in_task = 0;
                 } else if (in_routine) {
-                    if (routine_list.routine_count < MAX_ROUTINES) {
-                        routine_list.routines[routine_list.routine_count++] = current_routine;
-                        printf("Added routine: %s, tasks: %d, loop: %d, inf-loop: %s\n",
-                               current_routine.name, current_routine.task_count,
-                               current_routine.loop, current_routine.inf_loop ? "true" : "false");
+                    if (tasks.count == 0) {
+                        LOG_WARNING("Routine %s has no tasks, skipping it", list->arena.data + current_routine.name);
                     } else {
-                        fprintf(stderr, "Maximum number of routines reached\n");
+                        ok = append_routine(list, &current_routine, &tasks);
+                        LOG_DEBUG("Added routine: %s, tasks: %d, loop: %d, inf-loop: %s",
+                                  list->arena.data + current_routine.name, current_routine.task_count,
+                                  current_routine.loop, current_routine.inf_loop ? "true" : "false");
                     }
                     in_routine = 0;
                     in_tasks = 0;
-                    memset(&current_routine, 0, sizeof(Routine));
+                    reset_record(&current_routine, empty_name);
+                    tasks.count = 0;
                 }
                 break;
             case YAML_SEQUENCE_END_EVENT:
@@ -159,46 +354,671 @@ int read_routines_from_file(const char* filename) {
         if (event.type != YAML_STREAM_END_EVENT) {
             yaml_event_delete(&event);
         }
-    } while (event.type != YAML_STREAM_END_EVENT);
+    } while (ok && event.type != YAML_STREAM_END_EVENT);
 
     yaml_event_delete(&event);
+    task_buffer_free(&tasks);
+
+    if (!ok || empty_name == ARENA_INVALID) {
+        LOG_ERROR("Out of memory while loading routines");
+        return 0;
+    }
+    return 1;
+}
+
+int read_routines_from_file(const char* filename, RoutineList *list) {
+    FILE *file = fopen(filename, "r");
+    yaml_parser_t parser;
+
+    if (!file) {
+        LOG_ERROR("Failed to open file %s", filename);
+        return 0;
+    }
+
+    LOG_INFO("Reading routines from file: %s", filename);
+
+    if (!yaml_parser_initialize(&parser)) {
+        LOG_ERROR("Failed to initialize YAML parser");
+        fclose(file);
+        return 0;
+    }
+
+    yaml_parser_set_input_file(&parser, file);
+    int ok = parse_routines(&parser, list);
     yaml_parser_delete(&parser);
     fclose(file);
 
-    return routine_list.routine_count > 0;
+    if (!ok || !finalize_routines(list)) {
+        LOG_ERROR("Out of memory while loading routines from %s", filename);
+        return 0;
+    }
+
+    LOG_INFO("Loaded %d routines using %zu bytes of routine storage", list->routine_count, list->arena.used);
+    return list->routine_count > 0;
 }
 
-int load_routines(const char* filename) {
-    routine_list.routine_count = 0;
-    char* full_path = get_config_path(filename);
-    if (!full_path) {
-        LOG_ERROR("Could not find routine file: %s", filename);
+static int push_span(RoutineIndex *index, int *capacity, int count, const RoutineSpan *span) {
+    if (count > *capacity) {
+        int new_capacity = *capacity ? *capacity * 2 : 16;
+        RoutineSpan *spans = realloc(index->spans, new_capacity * sizeof(RoutineSpan));
+        if (!spans) {
+            return 0;
+        }
+        index->spans = spans;
+        *capacity = new_capacity;
+    }
+    index->spans[count - 1] = *span;
+    return 1;
+}
+
+static int index_value(const char *line, const char *end, const char *key, char *value, size_t size) {
+    size_t key_len = strlen(key);
+    if ((size_t)(end - line) <= key_len || strncmp(line, key, key_len) != 0 || line[key_len] != ':') {
         return 0;
     }
-    int result = read_routines_from_file(full_path);
-    if (!result) {
-        LOG_ERROR("Failed to read routines from file: %s", full_path);
+
+    const char *start = line + key_len + 1;
+    while (start < end && *start == ' ') {
+        start++;
+    }
+    const char *stop = start;
+    while (stop < end && !(*stop == '#' && stop > start && stop[-1] == ' ')) {
+        stop++;
+    }
+    while (stop > start && (stop[-1] == ' ' || stop[-1] == '\r')) {
+        stop--;
+    }
+    size_t len = stop - start;
+    if (len >= size || (len > 0 && strchr("\"'[{&*!|>%@`", *start))) {
+        return -1;
     }
-    return result;
+
+    memcpy(value, start, len);
+    value[len] = '\0';
+    return 1;
 }
 
-int move_to_next_task(void) {
+static int index_routines(const char *data, size_t size, RoutineList *list, RoutineIndex *index) {
+    uint32_t empty_name = arena_intern(&list->arena, "");
+    RoutineRecord record;
+    RoutineSpan span = {0};
+    TaskBuffer no_tasks = {0};
+    char value[256];
+    int span_capacity = 0;
+    int in_item = 0;
+    int has_name = 0;
+    long item_indent = -1;
+    long key_indent = -1;
+    size_t pos = 0;
+
+    if (empty_name == ARENA_INVALID) {
+        return 0;
+    }
+    reset_record(&record, empty_name);
+
+    while (pos <= size) {
+        const char *line = data + pos;
+        const char *newline = memchr(line, '\n', size - pos);
+        const char *end = newline ? newline : data + size;
+        size_t next = (size_t)(end - data) + 1;
+        const char *content = line;
+        while (content < end && *content == ' ') {
+            content++;
+        }
+        long indent = content - line;
+
+        int blank = content == end || *content == '#' || *content == '\r';
+        int item = !blank && *content == '-' && (content + 1 == end || content[1] == ' ') &&
+                   (item_indent == -1 || indent == item_indent);
+
+        if (in_item && (item || pos >= size)) {
+            span.end = pos < size ? pos : size;
+            if (has_name && (!append_routine(list, &record, &no_tasks) ||
+                             !push_span(index, &span_capacity, list->routine_count, &span))) {
+                return 0;
+            }
+            reset_record(&record, empty_name);
+            in_item = 0;
+            has_name = 0;
+        }
+        if (pos >= size) {
+            break;
+        }
+
+        if (item) {
+            item_indent = indent;
+            in_item = 1;
+            span.start = pos;
+            content++;
+            while (content < end && *content == ' ') {
+                content++;
+            }
+            if (key_indent == -1 && content < end) {
+                key_indent = content - line;
+            } else if (content < end && content - line != key_indent) {
+                return 0;
+            }
+        } else if (blank) {
+            pos = next;
+            continue;
+        } else {
+            if (!in_item || *content == '\t') {
+                return 0;
+            }
+            if (key_indent == -1) {
+                key_indent = indent;
+            }
+            if (indent > key_indent) {
+                pos = next;
+                continue;
+            }
+            if (indent != key_indent) {
+                return 0;
+            }
+        }
+
+        int found;
+        if ((found = index_value(content, end, "routine-name", value, sizeof(value))) == 1) {
+            record.name = arena_intern(&list->arena, value);
+            has_name = 1;
+            if (record.name == ARENA_INVALID) {
+                return 0;
+            }
+        } else if (found == 0 && (found = index_value(content, end, "loop", value, sizeof(value))) == 1) {
+            record.loop = atoi(value);
+        } else if (found == 0 && (found = index_value(content, end, "inf-loop", value, sizeof(value))) == 1) {
+            record.inf_loop = strcmp(value, "true") == 0;
+        }
+        if (found == -1) {
+            return 0;
+        }
+        pos = next;
+    }
+
+    return list->routine_count > 0;
+}
+
+static char *read_whole_file(const char *filename, size_t *size, struct stat *st) {
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return NULL;
+    }
+    if (fstat(fd, st) == -1) {
+        close(fd);
+        return NULL;
+    }
+
+    char *data = malloc(st->st_size + 1);
+    size_t total = 0;
+    while (data && total < (size_t)st->st_size) {
+        ssize_t n = read(fd, data + total, st->st_size - total);
+        if (n <= 0) {
+            break;
+        }
+        total += n;
+    }
+    close(fd);
+
+    if (data && total != (size_t)st->st_size) {
+        free(data);
+        data = NULL;
+    }
+    *size = total;
+    return data;
+}
+
+static int index_routines_from_file(const char *filename, RoutineList *list) {
+    struct stat st;
+    size_t size;
+    char *data = read_whole_file(filename, &size, &st);
+    if (!data) {
+        LOG_ERROR("Failed to read file %s", filename);
+        return 0;
+    }
+
+    list->index = calloc(1, sizeof(RoutineIndex));
+    if (!list->index || !(list->index->source_path = strdup(filename))) {
+        free(data);
+        return 0;
+    }
+    list->index->source_size = st.st_size;
+    list->index->source_mtime_sec = st.st_mtim.tv_sec;
+    list->index->source_mtime_nsec = st.st_mtim.tv_nsec;
+
+    int ok = index_routines(data, size, list, list->index) && finalize_routines(list);
+    free(data);
+    if (ok) {
+        LOG_INFO("Indexed %d routines in %s", list->routine_count, filename);
+    }
+    return ok;
+}
+
+static int load_routine_span(RoutineList *list, int routine) {
+    RoutineIndex *index = list->index;
+    RoutineSpan *span = &index->spans[routine];
+    struct stat st;
+
+    if (stat(index->source_path, &st) == -1 || st.st_size != index->source_size ||
+        st.st_mtim.tv_sec != index->source_mtime_sec || st.st_mtim.tv_nsec != index->source_mtime_nsec) {
+        LOG_WARNING("%s changed since it was indexed", index->source_path);
+        return 0;
+    }
+
+    size_t length = span->end - span->start;
+    char *buffer = malloc(length + 1);
+    if (!buffer) {
+        return 0;
+    }
+
+    int fd = open(index->source_path, O_RDONLY | O_CLOEXEC);
+    ssize_t n = fd == -1 ? -1 : pread(fd, buffer, length, span->start);
+    if (fd != -1) {
+        close(fd);
+    }
+    if (n != (ssize_t)length) {
+        free(buffer);
+        return 0;
+    }
+    yaml_parser_t parser;
+    if (!yaml_parser_initialize(&parser)) {
+        free(buffer);
+        return 0;
+    }
+    yaml_parser_set_input_string(&parser, (const unsigned char*)buffer, length);
+
+    int first = list->routine_count;
+    int ok = parse_routines(&parser, list) && list->routine_count <= first + 1;
+    yaml_parser_delete(&parser);
+    free(buffer);
+
+    if (!ok) {
+        list->routine_count = first;
+        return 0;
+    }
+    if (list->routine_count == first) {
+        span->loaded = 1;
+        return 1;
+    }
+
+    list->records[routine] = list->records[first];
+    list->routine_count = first;
+    span->loaded = 1;
+    return finalize_routines(list);
+}
+
+static int load_selected_routine(void) {
+    RoutineIndex *index = routine_list.index;
+    if (!index || index->spans[current_routine].loaded) {
+        return 1;
+    }
+
+    int64_t start = startup_now();
+    int loaded = load_routine_span(&routine_list, current_routine);
+    startup_phase("parse selected routine", start);
+    if (loaded) {
+        LOG_INFO("Parsed routine %s (%d tasks)", routine_list.routines[current_routine].name,
+                 routine_list.routines[current_routine].task_count);
+        return 1;
+    }
+
+    LOG_WARNING("Falling back to a full parse of %s", index->source_path);
+    char *name = strdup(routine_list.routines[current_routine].name);
+    char *source_path = strdup(index->source_path);
+    free_routines(&routine_list);
+    int ok = name && source_path && read_routines_from_file(source_path, &routine_list) && select_routine(name);
+    free(name);
+    free(source_path);
+    return ok;
+}
+
+static void *rebuild_routine_cache(void *arg) {
+    char *source_path = arg;
+    RoutineList list = {0};
+    struct stat source;
+
+    if (stat(source_path, &source) == 0 && read_routines_from_file(source_path, &list)) {
+        routine_cache_store(source_path, &source, &list);
+    }
+    free_routines(&list);
+    free(source_path);
+    return NULL;
+}
+
+static void start_cache_rebuild(const char *source_path) {
+    if (cache_thread_running) {
+        pthread_join(cache_thread, NULL);
+        cache_thread_running = 0;
+    }
+
+    char *path = strdup(source_path);
+    if (!path) {
+        return;
+    }
+
+    int error = start_worker_thread(&cache_thread, rebuild_routine_cache, path);
+
+    if (error != 0) {
+        LOG_WARNING("Failed to start routine cache rebuild: %s", strerror(error));
+        free(path);
+        return;
+    }
+    cache_thread_running = 1;
+}
+
+void cleanup_routines(void) {
+    if (cache_thread_running) {
+        pthread_join(cache_thread, NULL);
+        cache_thread_running = 0;
+    }
+    free_routines(&routine_list);
+}
+
+static int parse_routine_file(const char *path, RoutineList *list) {
+    struct stat source;
+
+    if (stat(path, &source) == -1 || !read_routines_from_file(path, list)) {
+        LOG_ERROR("Failed to read routines from file: %s", path);
+        return 0;
+    }
+    routine_cache_store(path, &source, list);
+    return 1;
+}
+
+static int load_routine_file(const char *path, RoutineList *list) {
+    if (routine_cache_load(path, list)) {
+        if (finalize_routines(list)) {
+            return 1;
+        }
+        free_routines(list);
+    }
+    return parse_routine_file(path, list);
+}
+
+static void *library_worker(void *arg) {
+    LibraryLoad *load = arg;
+    int i;
+
+    while ((i = atomic_fetch_add(&load->next, 1)) < load->count) {
+        load->loaded[i] = load_routine_file(load->paths[i], &load->lists[i]);
+    }
+    return NULL;
+}
+
+static int is_yaml_file(const struct dirent *entry) {
+    size_t len = strlen(entry->d_name);
+    return entry->d_name[0] != '.' && len > 5 && strcmp(entry->d_name + len - 5, ".yaml") == 0;
+}
+
+static int compare_entries(const struct dirent **a, const struct dirent **b) {
+    return strcmp((*a)->d_name, (*b)->d_name);
+}
+
+static void run_library_workers(LibraryLoad *load) {
+    pthread_t threads[LIBRARY_MAX_WORKERS];
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int workers = cores < 1 ? 1 : cores > LIBRARY_MAX_WORKERS ? LIBRARY_MAX_WORKERS : (int)cores;
+    int started = 0;
+
+    if (workers > load->count) {
+        workers = load->count;
+    }
+
+    while (started < workers - 1 && start_worker_thread(&threads[started], library_worker, load) == 0) {
+        started++;
+    }
+
+    library_worker(load);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    LOG_DEBUG("Loaded %d routine files on %d threads", load->count, started + 1);
+}
+
+static int merge_routine(RoutineList *merged, const Routine *routine, TaskBuffer *tasks) {
+    if (routine->task_count == 0) {
+        LOG_WARNING("Routine %s has no tasks, skipping it", routine->name);
+        return 1;
+    }
+
+    RoutineRecord record = {
+        .name = arena_intern(&merged->arena, routine->name),
+        .loop = routine->loop,
+        .inf_loop = routine->inf_loop,
+        .sound = arena_intern(&merged->arena, routine->sound),
+        .complete_sound = arena_intern(&merged->arena, routine->complete_sound),
+        .warning_sound = arena_intern(&merged->arena, routine->warning_sound),
+        .warn_before = routine->warn_before,
+    };
+
+    tasks->count = 0;
+    for (int i = 0; i < routine->task_count; i++) {
+        uint32_t name = arena_intern(&merged->arena, get_routine_task_name(routine, i));
+        uint32_t sound = arena_intern(&merged->arena, routine->strings + routine->task_sounds[i]);
+        if (name == ARENA_INVALID || sound == ARENA_INVALID ||
+            !task_buffer_push(tasks, name, routine->durations[i], sound)) {
+            return 0;
+        }
+    }
+    return record.name != ARENA_INVALID && record.sound != ARENA_INVALID &&
+           record.complete_sound != ARENA_INVALID && record.warning_sound != ARENA_INVALID &&
+           append_routine(merged, &record, tasks);
+}
+
+static int merge_routine_lists(RoutineList *merged, const LibraryLoad *load) {
+    TaskBuffer tasks = {0};
+    Arena seen;
+    int total = 0;
+    int ok = 1;
+
+    for (int i = 0; i < load->count; i++) {
+        total += load->loaded[i] ? load->lists[i].routine_count : 0;
+    }
+    int *origins = calloc(total ? total : 1, sizeof(int));
+    if (!origins) {
+        return 0;
+    }
+    arena_init(&seen);
+
+    for (int i = 0; ok && i < load->count; i++) {
+        const RoutineList *list = &load->lists[i];
+        for (int r = 0; ok && load->loaded[i] && r < list->routine_count; r++) {
+            const Routine *routine = &list->routines[r];
+            size_t known = seen.intern_count;
+            if (arena_intern(&seen, routine->name) == ARENA_INVALID) {
+                ok = 0;
+            } else if (seen.intern_count == known) {
+                int first = 0;
+                while (first < merged->routine_count &&
+                       strcmp(merged->arena.data + merged->records[first].name, routine->name) != 0) {
+                    first++;
+                }
+                LOG_WARNING("Duplicate routine '%s' in %s ignored, already defined in %s",
+                            routine->name, load->paths[i], load->paths[origins[first]]);
+            } else {
+                origins[merged->routine_count] = i;
+                ok = merge_routine(merged, routine, &tasks);
+            }
+        }
+    }
+
+    arena_free(&seen);
+    task_buffer_free(&tasks);
+    free(origins);
+    return ok && finalize_routines(merged);
+}
+
+static int load_routine_library(const char *directory, RoutineList *list) {
+    struct dirent **entries;
+    int count = scandir(directory, &entries, is_yaml_file, compare_entries);
+    if (count < 0) {
+        LOG_ERROR("Failed to scan routine directory %s: %s", directory, strerror(errno));
+        return 0;
+    }
+
+    LibraryLoad load = { .count = count };
+    load.paths = calloc(count ? count : 1, sizeof(char*));
+    load.lists = calloc(count ? count : 1, sizeof(RoutineList));
+    load.loaded = calloc(count ? count : 1, sizeof(int));
+    atomic_init(&load.next, 0);
+
+    int ok = load.paths && load.lists && load.loaded;
+    for (int i = 0; i < count; i++) {
+        size_t size = strlen(directory) + strlen(entries[i]->d_name) + 2;
+        if (ok && (load.paths[i] = malloc(size))) {
+            snprintf(load.paths[i], size, "%s/%s", directory, entries[i]->d_name);
+        } else {
+            ok = 0;
+        }
+        free(entries[i]);
+    }
+    free(entries);
+
+    if (ok) {
+        run_library_workers(&load);
+        for (int i = 0; i < count; i++) {
+            if (!load.loaded[i]) {
+                LOG_WARNING("Skipping routine file %s", load.paths[i]);
+            }
+        }
+        ok = merge_routine_lists(list, &load);
+    }
+
+    for (int i = 0; load.paths && load.lists && i < count; i++) {
+        free(load.paths[i]);
+        free_routines(&load.lists[i]);
+    }
+    free(load.paths);
+    free(load.lists);
+    free(load.loaded);
+
+    if (!ok) {
+        LOG_ERROR("Out of memory while loading routines from %s", directory);
+        free_routines(list);
+        return 0;
+    }
+    if (list->routine_count == 0) {
+        LOG_ERROR("No routines found in %s", directory);
+        return 0;
+    }
+
+    LOG_INFO("Loaded %d routines from %d files in %s", list->routine_count, count, directory);
+    return 1;
+}
+
+static int is_directory(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+int resolve_routines_path(const char *name, char *path, size_t size) {
+    char filename[512];
+
+    if (get_config_path(name, path, size) && is_directory(path)) {
+        return 1;
+    }
+    snprintf(filename, sizeof(filename), "%s.yaml", name);
+    if (!get_config_path(filename, path, size)) {
+        LOG_ERROR("Could not find routine file or directory: %s", name);
+        return 0;
+    }
+    return 1;
+}
+
+const char *get_routines_path(void) {
+    return routines_path;
+}
+
+int load_routines_from(const char *source_path, RoutineList *list) {
+    if (is_directory(source_path)) {
+        return load_routine_library(source_path, list);
+    }
+    return load_routine_file(source_path, list);
+}
+
+int load_routines(const char* name) {
+    const char *source_path = routines_path;
+
+    free_routines(&routine_list);
+    if (!resolve_routines_path(name, routines_path, sizeof(routines_path))) {
+        routines_path[0] = '\0';
+        return 0;
+    }
+    int64_t start = startup_now();
+    if (is_directory(source_path)) {
+        int ok = load_routine_library(source_path, &routine_list);
+        startup_phase("load routine library", start);
+        return ok;
+    }
+
+    int cached = routine_cache_load(source_path, &routine_list);
+    startup_phase("map routine cache", start);
+    if (cached) {
+        if (finalize_routines(&routine_list)) {
+            LOG_INFO("Loaded %d routines from cache for %s", routine_list.routine_count, source_path);
+            return routine_list.routine_count > 0;
+        }
+        free_routines(&routine_list);
+    }
+
+    start = startup_now();
+    if (index_routines_from_file(source_path, &routine_list)) {
+        startup_phase("index routines", start);
+        start_cache_rebuild(source_path);
+        return 1;
+    }
+    free_routines(&routine_list);
+
+    start = startup_now();
+    int ok = parse_routine_file(source_path, &routine_list);
+    startup_phase("parse routines", start);
+    return ok;
+}
+
+static int advance_task(void) {
     Routine* current_routine_ptr = &routine_list.routines[current_routine];
     current_task++;
     LOG_DEBUG("Moving to next task");
     if (current_task >= current_routine_ptr->task_count) {
-        if (current_routine_ptr->inf_loop || current_routine_ptr->loop > 1) {
+        if (current_routine_ptr->inf_loop || loops_remaining > 1) {
             current_task = 0;
             if (!current_routine_ptr->inf_loop) {
-                current_routine_ptr->loop--;
+                loops_remaining--;
             }
         } else {
+            current_task = current_routine_ptr->task_count - 1;
             return 0;
         }
     }
     return 1;
 }
 
+int move_to_next_task(void) {
+    if (!advance_task()) {
+        return 0;
+    }
+    start_current_task(now_ns());
+    return 1;
+}
+
+static int64_t next_task_start(void) {
+    int64_t now = now_ns();
+    if (now - task_countdown.deadline > NSEC_PER_SEC) {
+        LOG_INFO("Task ended %lld seconds ago, starting the next one now",
+                 (long long)((now - task_countdown.deadline) / NSEC_PER_SEC));
+        return now;
+    }
+    return task_countdown.deadline;
+}
+
+int finish_current_task(void) {
+    int64_t start = next_task_start();
+    if (!advance_task()) {
+        return 0;
+    }
+    start_current_task(start);
+    return 1;
+}
+
 void move_to_previous_task(void) {
     Routine* current_routine_ptr = &routine_list.routines[current_routine];
     if (current_task > 0) {
@@ -206,29 +1026,83 @@ void move_to_previous_task(void) {
     } else {
         current_task = current_routine_ptr->task_count - 1;
     }
+    start_current_task(now_ns());
 }
 
 void extend_current_task(int seconds) {
-    Routine* current_routine_ptr = &routine_list.routines[current_routine];
-    current_routine_ptr->tasks[current_task].duration += seconds;
+    int warn_before = routine_list.routines[current_routine].warn_before;
+    countdown_extend(&task_countdown, (int64_t)seconds * NSEC_PER_SEC);
+    if (warn_before > 0 && countdown_remaining(&task_countdown) > (int64_t)warn_before * NSEC_PER_SEC) {
+        warning_pending = 1;
+    }
+    publish_task_state();
+}
+
+int pause_current_task(void) {
+    if (!countdown_pause(&task_countdown)) {
+        return 0;
+    }
+    publish_task_state();
+    return 1;
+}
+
+int resume_current_task(void) {
+    if (!countdown_resume(&task_countdown)) {
+        return 0;
+    }
+    publish_task_state();
+    return 1;
+}
+
+int is_task_paused(void) {
+    return task_countdown.paused;
+}
+
+int64_t get_task_remaining_ns(void) {
+    return countdown_remaining(&task_countdown);
+}
+
+int64_t get_next_tick_time(void) {
+    return countdown_next_tick(&task_countdown);
 }
 
 const char* get_current_task_name(void) {
-    Routine* current_routine_ptr = &routine_list.routines[current_routine];
-    return current_routine_ptr->tasks[current_task].name;
+    return get_routine_task_name(&routine_list.routines[current_routine], current_task);
 }
 
-int get_current_task_duration(void) {
-    Routine* current_routine_ptr = &routine_list.routines[current_routine];
-    return current_routine_ptr->tasks[current_task].duration;
+const char* get_current_task_sound(void) {
+    return get_routine_task_sound(&routine_list.routines[current_routine], current_task);
 }
 
-void set_task_start_time(time_t new_start_time) {
-    task_start_time = new_start_time;
+int64_t get_next_sound_ns(void) {
+    int64_t remaining = countdown_remaining(&task_countdown);
+    if (warning_pending) {
+        return remaining - (int64_t)routine_list.routines[current_routine].warn_before * NSEC_PER_SEC;
+    }
+    return remaining;
 }
 
-time_t get_task_start_time(void) {
-    return task_start_time;
+const char* get_next_sound_name(void) {
+    if (warning_pending) {
+        return routine_list.routines[current_routine].warning_sound;
+    }
+    return get_current_task_sound();
+}
+
+int take_task_warning(void) {
+    if (!warning_pending || task_countdown.paused || get_next_sound_ns() > 0) {
+        return 0;
+    }
+    warning_pending = 0;
+    return 1;
+}
+
+int get_current_task_index(void) {
+    return current_task;
+}
+
+int get_current_task_duration(void) {
+    return routine_list.routines[current_routine].durations[current_task];
 }
 
 int initialize_tasks() {
@@ -237,12 +1111,81 @@ int initialize_tasks() {
         return 0;
     }
 
+    if (!load_selected_routine()) {
+        LOG_ERROR("Failed to load tasks for routine %s", routine_list.routines[current_routine].name);
+        return 0;
+    }
+    if (routine_list.routines[current_routine].task_count == 0) {
+        LOG_ERROR("Routine %s has no tasks", routine_list.routines[current_routine].name);
+        return 0;
+    }
+
+    set_timekeeping_clock(config.count_suspend ? CLOCK_BOOTTIME : CLOCK_MONOTONIC);
     current_task = 0;
-    task_start_time = time(NULL);
+    loops_remaining = routine_list.routines[current_routine].loop;
+    memset(&task_countdown, 0, sizeof(task_countdown));
+    start_current_task(now_ns());
     LOG_INFO("Tasks initialized for routine: %s", routine_list.routines[current_routine].name);
     return 1;
 }
 
+static int find_task(const Routine *routine, const char *name, int hint) {
+    if (hint < routine->task_count && strcmp(get_routine_task_name(routine, hint), name) == 0) {
+        return hint;
+    }
+    for (int i = 0; i < routine->task_count; i++) {
+        if (strcmp(get_routine_task_name(routine, i), name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int replace_routines(RoutineList *fresh) {
+    const Routine *old_routine = &routine_list.routines[current_routine];
+    int routine = 0;
+
+    while (routine < fresh->routine_count && strcmp(fresh->routines[routine].name, old_routine->name) != 0) {
+        routine++;
+    }
+    if (routine == fresh->routine_count) {
+        LOG_WARNING("Routine %s is no longer defined, keeping the loaded routines", old_routine->name);
+        return 0;
+    }
+
+    const Routine *new_routine = &fresh->routines[routine];
+    if (new_routine->task_count == 0) {
+        LOG_WARNING("Routine %s no longer has any tasks, keeping the loaded routines", old_routine->name);
+        return 0;
+    }
+    int task = find_task(new_routine, get_current_task_name(), current_task);
+    if (task >= 0) {
+        int64_t delta = (int64_t)new_routine->durations[task] - old_routine->durations[current_task];
+        countdown_extend(&task_countdown, delta * NSEC_PER_SEC);
+    } else {
+        LOG_INFO("Task %s was removed from routine %s, restarting the routine",
+                 get_current_task_name(), old_routine->name);
+    }
+
+    int loops_done = old_routine->loop - loops_remaining;
+    loops_remaining = new_routine->loop - loops_done > 1 ? new_routine->loop - loops_done : 1;
+
+    RoutineList old = routine_list;
+    routine_list = *fresh;
+    memset(fresh, 0, sizeof(*fresh));
+    current_routine = routine;
+
+    if (task >= 0) {
+        current_task = task;
+        publish_task_state();
+    } else {
+        current_task = 0;
+        start_current_task(now_ns());
+    }
+    free_routines(&old);
+    return 1;
+}
+
 int select_routine(const char* routine_name) {
     for (int i = 0; i < routine_list.routine_count; i++) {
         if (strcmp(routine_list.routines[i].name, routine_name) == 0) {
@@ -263,7 +1206,17 @@ void list_routines() {
 }
 
 void reset_routine() {
+    int64_t start = next_task_start();
     current_task = 0;
-    task_start_time = time(NULL);
+    start_current_task(start);
     LOG_INFO("Routine reset");
 }
+
+int start_next_routine_loop(void) {
+    Routine* current_routine_ptr = &routine_list.routines[current_routine];
+    if (!current_routine_ptr->inf_loop && --loops_remaining <= 0) {
+        return 0;
+    }
+    reset_routine();
+    return 1;
+}
@@ -0,0 +1,11 @@
+#include "thread.h"
+#include <signal.h>
+
+int start_worker_thread(pthread_t *thread, void *(*function)(void *), void *arg) {
+    sigset_t all_signals, previous;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &previous);
+    int error = pthread_create(thread, NULL, function, arg);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    return error;
+}
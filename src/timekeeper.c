@@ -0,0 +1,71 @@
+#include "timekeeper.h"
+
+static clockid_t timekeeping_clock = CLOCK_MONOTONIC;
+
+void set_timekeeping_clock(clockid_t clock_id) {
+    timekeeping_clock = clock_id;
+}
+
+clockid_t get_timekeeping_clock(void) {
+    return timekeeping_clock;
+}
+
+int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(timekeeping_clock, &ts);
+    return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+int ns_to_display_seconds(int64_t ns) {
+    if (ns <= 0) {
+        return 0;
+    }
+    return (int)((ns + NSEC_PER_SEC - 1) / NSEC_PER_SEC);
+}
+
+void countdown_start(Countdown *countdown, int64_t duration) {
+    countdown_start_at(countdown, now_ns(), duration);
+}
+
+void countdown_start_at(Countdown *countdown, int64_t start, int64_t duration) {
+    countdown->deadline = start + duration;
+    countdown->paused_at = 0;
+    countdown->paused = 0;
+}
+
+int countdown_pause(Countdown *countdown) {
+    if (countdown->paused) {
+        return 0;
+    }
+    countdown->paused_at = now_ns();
+    countdown->paused = 1;
+    return 1;
+}
+
+int countdown_resume(Countdown *countdown) {
+    if (!countdown->paused) {
+        return 0;
+    }
+    countdown->deadline += now_ns() - countdown->paused_at;
+    countdown->paused_at = 0;
+    countdown->paused = 0;
+    return 1;
+}
+
+void countdown_extend(Countdown *countdown, int64_t amount) {
+    countdown->deadline += amount;
+}
+
+int64_t countdown_remaining(const Countdown *countdown) {
+    int64_t reference = countdown->paused ? countdown->paused_at : now_ns();
+    return countdown->deadline - reference;
+}
+
+/* Absolute time at which the displayed whole-second value next changes. */
+int64_t countdown_next_tick(const Countdown *countdown) {
+    int seconds = ns_to_display_seconds(countdown_remaining(countdown));
+    if (seconds <= 0) {
+        return countdown->deadline;
+    }
+    return countdown->deadline - (int64_t)(seconds - 1) * NSEC_PER_SEC;
+}
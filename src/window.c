@@ -1,6 +1,8 @@
 #include "window.h"
 #include "error_report.h"
 #include "config.h"
+#include "overlay.h"
+#include "startup.h"
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/Xatom.h>
@@ -14,12 +16,16 @@ GC gc = NULL;
 int screen = 0;
 Visual *visual = NULL;
 int depth = 0;
+int window_width = 0;
+int window_height = 0;
 XSetWindowAttributes attrs;
 
 int initialize_display() {
     LOG_INFO("Initializing display...");
 
+    int64_t start = startup_now();
     dpy = XOpenDisplay(NULL);
+    startup_phase("XOpenDisplay", start);
     if (dpy == NULL) {
         LOG_ERROR("Cannot open display");
         return 0;
@@ -65,7 +71,9 @@ void create_transparent_window() {
     attrs.background_pixel = 0;
 
     int num_screens;
+    int64_t start = startup_now();
     XineramaScreenInfo *screen_info = XineramaQueryScreens(dpy, &num_screens);
+    startup_phase("Xinerama query", start);
     if (screen_info == NULL || num_screens == 0) {
         LOG_ERROR("Xinerama is not active or no screens found");
         exit(1);
@@ -132,6 +140,7 @@ void create_transparent_window() {
 
     LOG_INFO("Creating window with dimensions: %dx%d at position (%d, %d)", width, height, x, y);
 
+    start = startup_now();
     win = XCreateWindow(dpy, root, x, y, width, height, 0, depth, InputOutput, visual,
                         CWColormap | CWBorderPixel | CWBackPixel, &attrs);
 
@@ -148,7 +157,12 @@ void create_transparent_window() {
     Atom wm_top = XInternAtom(dpy, "_NET_WM_STATE_ABOVE", False);
     XChangeProperty(dpy, win, wm_state, XA_ATOM, 32, PropModeReplace, (unsigned char *)&wm_top, 1);
 
+    window_width = width;
+    window_height = height;
+
+    XSelectInput(dpy, win, ExposureMask | StructureNotifyMask);
     XMapWindow(dpy, win);
+    startup_phase("create window", start);
     LOG_DEBUG("Window mapped");
 }
 
@@ -165,9 +179,36 @@ void cleanup_display() {
     LOG_INFO("Display cleaned up");
 }
 
+Display *get_display(void) {
+    return dpy;
+}
+
+int get_display_fd(void) {
+    return ConnectionNumber(dpy);
+}
+
+int x11_events_queued(void) {
+    return XEventsQueued(dpy, QueuedAlready);
+}
+
 void handle_x11_events() {
     XEvent ev;
     while (XPending(dpy)) {
         XNextEvent(dpy, &ev);
+        switch (ev.type) {
+            case Expose:
+                if (ev.xexpose.count == 0) {
+                    overlay_invalidate();
+                }
+                break;
+            case ConfigureNotify:
+                if (ev.xconfigure.width != window_width || ev.xconfigure.height != window_height) {
+                    window_width = ev.xconfigure.width;
+                    window_height = ev.xconfigure.height;
+                    LOG_DEBUG("Window resized to %dx%d", window_width, window_height);
+                    overlay_invalidate();
+                }
+                break;
+        }
     }
 }
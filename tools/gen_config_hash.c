@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Build-time helper: finds a seed for which every key in config_keys.def lands in its
+ * own slot and writes the hash function and slot table as a header on stdout.
+ */
+
+static const char *keys[] = {
+#define CONFIG_KEY(name, type, default_value, validator, apply) #name,
+#include "config_keys.def"
+#undef CONFIG_KEY
+};
+
+#define KEY_COUNT (sizeof(keys) / sizeof(keys[0]))
+#define MAX_SEEDS 10000000u
+
+static uint32_t hash_key(const char *key, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash ^ (hash >> 15);
+}
+
+int main(void) {
+    unsigned table_size = 1;
+    int slots[256];
+
+    while (table_size < 2 * KEY_COUNT) {
+        table_size *= 2;
+    }
+    if (table_size > sizeof(slots) / sizeof(slots[0])) {
+        fprintf(stderr, "gen_config_hash: too many keys\n");
+        return 1;
+    }
+
+    for (uint32_t seed = 0; seed < MAX_SEEDS; seed++) {
+        size_t i;
+        memset(slots, -1, sizeof(slots));
+        for (i = 0; i < KEY_COUNT; i++) {
+            uint32_t slot = hash_key(keys[i], seed) & (table_size - 1);
+            if (slots[slot] != -1) {
+                break;
+            }
+            slots[slot] = (int)i;
+        }
+        if (i < KEY_COUNT) {
+            continue;
+        }
+
+        printf("/* Generated by tools/gen_config_hash.c from include/config_keys.def. Do not edit. */\n");
+        printf("#ifndef CONFIG_HASH_H\n#define CONFIG_HASH_H\n\n");
+        printf("#define CONFIG_HASH_SEED %uu\n", seed);
+        printf("#define CONFIG_HASH_SIZE %u\n\n", table_size);
+        printf("static const signed char config_hash_slots[CONFIG_HASH_SIZE] = {");
+        for (unsigned slot = 0; slot < table_size; slot++) {
+            printf("%s%d,", slot % 16 == 0 ? "\n    " : " ", slots[slot]);
+        }
+        printf("\n};\n\n");
+        printf("static uint32_t config_hash(const char *key) {\n");
+        printf("    uint32_t hash = 2166136261u ^ CONFIG_HASH_SEED;\n");
+        printf("    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {\n");
+        printf("        hash = (hash ^ *p) * 16777619u;\n");
+        printf("    }\n");
+        printf("    return (hash ^ (hash >> 15)) & (CONFIG_HASH_SIZE - 1);\n");
+        printf("}\n\n#endif\n");
+        return 0;
+    }
+
+    fprintf(stderr, "gen_config_hash: no perfect hash seed found\n");
+    return 1;
+}